@@ -0,0 +1,82 @@
+#
+# Module that checks whether ZSTD is available and usable.
+#
+# Variables used by this module which you may want to set:
+# ZSTD_ROOT         Path list to search for ZSTD
+#
+# Sets the follwing variable:
+#
+# ZSTD_FOUND           True if ZSTD available and usable.
+# ZSTD_INCLUDE_DIRS    Path to the ZSTD include dirs.
+# ZSTD_LIBRARIES       Name to the ZSTD library.
+#
+
+# look for header files, only at positions given by the user
+find_path(ZSTD_INCLUDE_DIR
+  NAMES zstd.h
+  PATHS ${ZSTD_PREFIX} ${ZSTD_ROOT}
+  PATH_SUFFIXES "include"
+  NO_DEFAULT_PATH
+)
+
+# look for header files, including default paths
+find_path(ZSTD_INCLUDE_DIR
+  NAMES zstd.h
+  PATH_SUFFIXES "include"
+)
+
+# look for library, only at positions given by the user
+find_library(ZSTD_LIBRARY
+  NAMES "zstd"
+  PATHS ${ZSTD_PREFIX} ${ZSTD_ROOT} ${ZSTD_ROOT}/lib/
+  PATH_SUFFIXES "lib" "lib32" "lib64"
+  NO_DEFAULT_PATH
+)
+
+# look for library files, including default paths
+find_library(ZSTD_LIBRARY
+  NAMES "zstd"
+  PATH_SUFFIXES "lib" "lib32" "lib64"
+)
+
+# check version specific macros
+include(CheckCSourceCompiles)
+include(CMakePushCheckState)
+cmake_push_check_state()
+
+# we need if clauses here because variable is set variable-NOTFOUND
+#
+if(ZSTD_INCLUDE_DIR)
+  set(CMAKE_REQUIRED_INCLUDES ${CMAKE_REQUIRED_INCLUDES} ${ZSTD_INCLUDE_DIR})
+endif(ZSTD_INCLUDE_DIR)
+if(ZSTD_LIBRARY)
+  set(CMAKE_REQUIRED_LIBRARIES ${CMAKE_REQUIRED_LIBRARIES} ${ZSTD_LIBRARY})
+endif(ZSTD_LIBRARY)
+
+# handle package arguments
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(
+  "ZSTD"
+  DEFAULT_MSG
+  ZSTD_INCLUDE_DIR
+  ZSTD_LIBRARY
+)
+
+mark_as_advanced(ZSTD_INCLUDE_DIR ZSTD_LIBRARY)
+
+# if both headers and library are found, store results
+if(ZSTD_FOUND)
+  set(ZSTD_INCLUDE_DIRS ${ZSTD_INCLUDE_DIR})
+  set(ZSTD_LIBRARIES    ${ZSTD_LIBRARY})
+  # log result
+  file(APPEND ${CMAKE_BINARY_DIR}${CMAKE_FILES_DIRECTORY}/CMakeOutput.log
+    "Determining location of ZSTD succeeded:\n"
+    "Include directory: ${ZSTD_INCLUDE_DIRS}\n"
+    "Library directory: ${ZSTD_LIBRARIES}\n\n")
+else(ZSTD_FOUND)
+  # log errornous result
+  file(APPEND ${CMAKE_BINARY_DIR}${CMAKE_FILES_DIRECTORY}/CMakeError.log
+    "Determining location of ZSTD failed:\n"
+    "Include directory: ${ZSTD_INCLUDE_DIRS}\n"
+    "Library directory: ${ZSTD_LIBRARIES}\n\n")
+endif(ZSTD_FOUND)
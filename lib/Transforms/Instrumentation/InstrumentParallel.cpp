@@ -22,18 +22,27 @@
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/LegacyPassManager.h"
@@ -49,6 +58,7 @@
 #include "llvm/Transforms/Utils/EscapeEnumerator.h"
 //#include "llvm/Transforms/Utils/Local.h"
 #include "llvm/Transforms/Utils/ModuleUtils.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 #include "sword/LinkAllPasses.h"
 
@@ -98,10 +108,54 @@ STATISTIC(NumOmittedReadsFromConstantGlobals,
           "Number of reads from constant globals");
 STATISTIC(NumOmittedReadsFromVtable, "Number of vtable reads");
 STATISTIC(NumOmittedNonCaptured, "Number of accesses ignored due to capturing");
+STATISTIC(NumInlinedAccesses, "Number of accesses appended inline to the trace buffer");
+STATISTIC(NumAccessSites, "Number of access sites given a site ID");
+STATISTIC(NumLoopRanges, "Number of loop accesses recorded as a range");
+STATISTIC(NumInstrumentedMemIntrinsics, "Number of instrumented memset/memcpy/memmove");
+
+static cl::opt<bool> ClInlineFastPath(
+    "sword-inline-fastpath", cl::init(false),
+    cl::desc("Append data accesses to the trace buffer inline and only call "
+             "the run-time when the buffer is full"),
+    cl::Hidden);
+
+static cl::opt<bool> ClSiteIds(
+    "sword-site-ids", cl::init(false),
+    cl::desc("Give every instrumented load and store a site ID and record "
+             "(site, address) instead of (size_type, address, pc)"),
+    cl::Hidden);
+
+static cl::opt<bool> ClInstrumentMemIntrinsics(
+    "sword-instrument-memintrinsics", cl::init(true),
+    cl::desc("Replace memset/memcpy/memmove with run-time calls that record "
+             "the accessed ranges"),
+    cl::Hidden);
+
+static cl::opt<bool> ClLoopRanges(
+    "sword-loop-ranges", cl::init(false),
+    cl::desc("Record the loads and stores of innermost loops with an affine "
+             "address and a computable trip count with one range call in "
+             "the loop preheader"),
+    cl::Hidden);
 
 
 #define MIN_VERSION 39
 
+// Layout of a data_access TraceItem (see rtl/sword_common.h): the
+// CallbackType byte, the size/type byte, the 64-bit address and the
+// 48-bit pc, for 16 bytes in total. The buffer is flushed by the run-time
+// once __sword_block_items__ items have been appended; the run-time adapts
+// that size, up to NUM_OF_ACCESSES, to the compression backlog.
+static const uint64_t kTraceItemSize = 16;
+static const uint64_t kTraceItemSizeTypeOffset = 1;
+static const uint64_t kTraceItemAddressOffset = 2;
+static const uint64_t kTraceItemPCOffset = 10;
+// A site_access TraceItem: the CallbackType byte, the 32-bit site ID and
+// the 64-bit address.
+static const uint64_t kTraceItemSiteAccess = 12;
+static const uint64_t kTraceItemSiteOffset = 1;
+static const uint64_t kTraceItemSiteAddressOffset = 5;
+
 
 #define TLS_DECLARE(var, type, name, initializer)			\
   if(!var) {								\
@@ -138,6 +192,7 @@ namespace {
     void getAnalysisUsage(AnalysisUsage &AU) const override;
     bool runOnFunction(Function &F) override;
     bool doInitialization(Module &M) override;
+    bool doFinalization(Module &M) override;
     static char ID;  // Pass identification, replacement for typeid.
     
  private:
@@ -145,6 +200,18 @@ namespace {
     bool instrumentLoadOrStore(Instruction *I, const DataLayout &DL);
     bool instrumentAtomic(Instruction *I, const DataLayout &DL);
     bool instrumentMemIntrinsic(Instruction *I);
+    bool instrumentInlineAccess(Instruction *I, Value *Addr, int Idx,
+                                bool IsWrite, Value *SiteId);
+    Value *getSiteId(Instruction *I, int Idx, bool IsWrite,
+                     Instruction *InsertBefore = nullptr);
+    bool instrumentLoopRanges(Function &F,
+                              SmallVectorImpl<Instruction *> &All,
+                              const DataLayout &DL, TargetLibraryInfo &TLI);
+    bool instrumentLoopRange(Instruction *I, LoopInfo &LI, ScalarEvolution &SE,
+                             DominatorTree &DT, SCEVExpander &Expander,
+                             DenseMap<Loop *, bool> &CallFree,
+                             const DataLayout &DL);
+    Constant *getSiteString(Module *M, StringRef Str);
   void chooseInstructionsToInstrument(SmallVectorImpl<Instruction *> &Local,
                                       SmallVectorImpl<Instruction *> &All,
                                       const DataLayout &DL);
@@ -180,6 +247,26 @@ namespace {
   Function *SwordVptrLoad;
   Function *MemmoveFn, *MemcpyFn, *MemsetFn;
   Function *SwordCtorFunction;
+  Function *SwordFlushBuffer;
+  // Thread-local trace cursor, buffer and block size used by the inline
+  // fast path.
+  GlobalVariable *SwordTraceIndex;
+  GlobalVariable *SwordTraceBuffer;
+  GlobalVariable *SwordTraceBlockItems;
+  // Site table of the module (-sword-site-ids): one SwordSite (see
+  // rtl/sword_common.h) per instrumented access, registered with the
+  // run-time by a module constructor that stores the ID of the first site
+  // in SwordSiteBase.
+  Function *SwordSiteAccess;
+  // Range callbacks of -sword-loop-ranges.
+  Function *SwordReadRange[kNumberOfAccessSizes];
+  Function *SwordWriteRange[kNumberOfAccessSizes];
+  Function *SwordSiteRange;
+  Function *SwordRegisterSites;
+  GlobalVariable *SwordSiteBase;
+  StructType *SwordSiteTy;
+  std::vector<Constant *> SiteEntries;
+  StringMap<Constant *> SiteStrings;
 };
 }  // namespace
 
@@ -220,6 +307,7 @@ void InstrumentParallel::initializeCallbacks(Module &M) {
   Attr = Attr.addAttribute(M.getContext(), AttributeList::FunctionIndex,
                            Attribute::NoUnwind);
   // Initialize the callbacks.
+  IntptrTy = M.getDataLayout().getIntPtrType(M.getContext());
   OrdTy = IRB.getInt32Ty();
   for (size_t i = 0; i < kNumberOfAccessSizes; ++i) {
     const unsigned ByteSize = 1U << i;
@@ -234,6 +322,16 @@ void InstrumentParallel::initializeCallbacks(Module &M) {
     SwordWrite[i] = checkSanitizerInterfaceFunction(M.getOrInsertFunction(
         WriteName, Attr, IRB.getVoidTy(), IRB.getInt8PtrTy()));
 
+    SmallString<32> ReadRangeName("__sword_read_range" + ByteSizeStr);
+    SwordReadRange[i] = checkSanitizerInterfaceFunction(M.getOrInsertFunction(
+        ReadRangeName, Attr, IRB.getVoidTy(), IRB.getInt8PtrTy(),
+        IRB.getInt64Ty(), IRB.getInt64Ty()));
+
+    SmallString<32> WriteRangeName("__sword_write_range" + ByteSizeStr);
+    SwordWriteRange[i] = checkSanitizerInterfaceFunction(M.getOrInsertFunction(
+        WriteRangeName, Attr, IRB.getVoidTy(), IRB.getInt8PtrTy(),
+        IRB.getInt64Ty(), IRB.getInt64Ty()));
+
     SmallString<64> UnalignedReadName("__sword_unaligned_read" + ByteSizeStr);
     SwordUnalignedRead[i] =
         checkSanitizerInterfaceFunction(M.getOrInsertFunction(
@@ -288,6 +386,23 @@ void InstrumentParallel::initializeCallbacks(Module &M) {
       "__sword_atomic_thread_fence", Attr, IRB.getVoidTy(), OrdTy));
   SwordAtomicSignalFence = checkSanitizerInterfaceFunction(M.getOrInsertFunction(
       "__sword_atomic_signal_fence", Attr, IRB.getVoidTy(), OrdTy));
+  SwordFlushBuffer = checkSanitizerInterfaceFunction(M.getOrInsertFunction(
+      "__sword_flush_buffer", Attr, IRB.getVoidTy()));
+  SwordSiteAccess = checkSanitizerInterfaceFunction(M.getOrInsertFunction(
+      "__sword_site_access", Attr, IRB.getVoidTy(), IRB.getInt8PtrTy(),
+      IRB.getInt32Ty()));
+  MemmoveFn = checkSanitizerInterfaceFunction(M.getOrInsertFunction(
+      "__sword_memmove", Attr, IRB.getInt8PtrTy(), IRB.getInt8PtrTy(),
+      IRB.getInt8PtrTy(), IntptrTy));
+  MemcpyFn = checkSanitizerInterfaceFunction(M.getOrInsertFunction(
+      "__sword_memcpy", Attr, IRB.getInt8PtrTy(), IRB.getInt8PtrTy(),
+      IRB.getInt8PtrTy(), IntptrTy));
+  MemsetFn = checkSanitizerInterfaceFunction(M.getOrInsertFunction(
+      "__sword_memset", Attr, IRB.getInt8PtrTy(), IRB.getInt8PtrTy(),
+      IRB.getInt32Ty(), IntptrTy));
+  SwordSiteRange = checkSanitizerInterfaceFunction(M.getOrInsertFunction(
+      "__sword_site_range", Attr, IRB.getVoidTy(), IRB.getInt8PtrTy(),
+      IRB.getInt64Ty(), IRB.getInt64Ty(), IRB.getInt32Ty()));
 }
 
 bool InstrumentParallel::doInitialization(Module &M) {
@@ -311,9 +426,109 @@ bool InstrumentParallel::doInitialization(Module &M) {
                                        llvm::GlobalValue::PrivateLinkage, Zero64,
                                        "function_max", NULL,
                                        GlobalVariable::NotThreadLocal, 0, false);
+  SwordCtorFunction = nullptr;
+  SwordSiteBase = nullptr;
+  SiteEntries.clear();
+  SiteStrings.clear();
+  if (ClSiteIds) {
+    // struct SwordSite { uint32_t line; uint32_t column; uint8_t size_type;
+    //                    const char *file; const char *function; };
+    SwordSiteTy = StructType::create(M.getContext(),
+                                     {IRB.getInt32Ty(), IRB.getInt32Ty(),
+                                      IRB.getInt8Ty(), IRB.getInt8PtrTy(),
+                                      IRB.getInt8PtrTy()},
+                                     "struct.SwordSite");
+    SwordSiteBase = new llvm::GlobalVariable(M, IRB.getInt32Ty(), false,
+                                             llvm::GlobalValue::InternalLinkage,
+                                             ConstantInt::get(IRB.getInt32Ty(), 0),
+                                             "__sword_site_base", NULL,
+                                             GlobalVariable::NotThreadLocal, 0, false);
+  }
   return true;
 }
 
+// Emits the site table of the module and the constructor that registers it:
+//
+//   static SwordSite __sword_sites[] = { ... };
+//   ctor() { __sword_register_sites(__sword_sites, N, &__sword_site_base); }
+//
+// The table is registered rather than collected from a custom section: the
+// IDs of a module start after the sites of the modules registered before
+// it, dlopen()ed libraries included, while __start_/__stop_ bound the
+// section of one executable or library only.
+bool InstrumentParallel::doFinalization(Module &M) {
+  if (!ClSiteIds || SiteEntries.empty())
+    return false;
+
+  IRBuilder<> IRB(M.getContext());
+  ArrayType *TableTy = ArrayType::get(SwordSiteTy, SiteEntries.size());
+  GlobalVariable *Table = new GlobalVariable(
+      M, TableTy, true, GlobalValue::PrivateLinkage,
+      ConstantArray::get(TableTy, SiteEntries), "__sword_sites");
+
+  SwordRegisterSites = checkSanitizerInterfaceFunction(M.getOrInsertFunction(
+      "__sword_register_sites", IRB.getVoidTy(),
+      SwordSiteTy->getPointerTo(), IRB.getInt32Ty(),
+      IRB.getInt32Ty()->getPointerTo()));
+  SwordCtorFunction = Function::Create(
+      FunctionType::get(IRB.getVoidTy(), false), GlobalValue::InternalLinkage,
+      "sword.module_ctor", &M);
+  BasicBlock *BB = BasicBlock::Create(M.getContext(), "", SwordCtorFunction);
+  IRBuilder<> CtorIRB(ReturnInst::Create(M.getContext(), BB));
+  CtorIRB.CreateCall(SwordRegisterSites,
+                     {CtorIRB.CreateConstInBoundsGEP2_32(TableTy, Table, 0, 0),
+                      CtorIRB.getInt32(SiteEntries.size()), SwordSiteBase});
+  appendToGlobalCtors(M, SwordCtorFunction, 0);
+
+  SiteEntries.clear();
+  return true;
+}
+
+Constant *InstrumentParallel::getSiteString(Module *M, StringRef Str) {
+  Constant *&C = SiteStrings[Str];
+  if (!C) {
+    Constant *Init = ConstantDataArray::getString(M->getContext(), Str);
+    GlobalVariable *GV = new GlobalVariable(
+        *M, Init->getType(), true, GlobalValue::PrivateLinkage, Init,
+        "__sword_site_str");
+    GV->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+    C = ConstantExpr::getPointerCast(GV, Type::getInt8PtrTy(M->getContext()));
+  }
+  return C;
+}
+
+// Returns the run-time site ID of I, i.e. __sword_site_base + its index in
+// the site table of the module, computed before InsertBefore (I by default).
+Value *InstrumentParallel::getSiteId(Instruction *I, int Idx, bool IsWrite,
+                                     Instruction *InsertBefore) {
+  IRBuilder<> IRB(InsertBefore ? InsertBefore : I);
+  Module *M = I->getModule();
+  unsigned Line = 0, Column = 0;
+  StringRef FileName;
+  if (const DebugLoc &Loc = I->getDebugLoc()) {
+    Line = Loc.getLine();
+    Column = Loc.getCol();
+    if (DILocation *DIL = dyn_cast<DILocation>(Loc.getAsMDNode()))
+      FileName = DIL->getFilename();
+  }
+  // Report the original name of the functions cloned by runOnFunction.
+  StringRef FunctionName = I->getFunction()->getName();
+  if (FunctionName.endswith("__sword__"))
+    FunctionName = FunctionName.drop_back(strlen("__sword__"));
+
+  // Same encoding as Access::setData(): size in the high nibble, type in the
+  // low one.
+  uint8_t SizeType = (Idx << 4) | (IsWrite ? 1 : 0);
+  uint32_t Local = SiteEntries.size();
+  SiteEntries.push_back(ConstantStruct::get(
+      SwordSiteTy, {IRB.getInt32(Line), IRB.getInt32(Column),
+                    IRB.getInt8(SizeType), getSiteString(M, FileName),
+                    getSiteString(M, FunctionName)}));
+  NumAccessSites++;
+  return IRB.CreateAdd(IRB.CreateLoad(SwordSiteBase, "__sword_site_base"),
+                       IRB.getInt32(Local), "__sword_site");
+}
+
 static bool isVtableAccess(Instruction *I) {
   if (MDNode *Tag = I->getMetadata(LLVMContext::MD_tbaa))
     return Tag->isTBAAVtableAccess();
@@ -534,6 +749,20 @@ static bool isAtomic(Instruction *I) {
 //   }
 // }
 
+// Promotes the allocas of F that are only loaded and stored to registers.
+static bool promoteAllocas(Function &F) {
+  SmallVector<AllocaInst *, 16> Allocas;
+  for (Instruction &I : F.getEntryBlock())
+    if (AllocaInst *AI = dyn_cast<AllocaInst>(&I))
+      if (isAllocaPromotable(AI))
+        Allocas.push_back(AI);
+  if (Allocas.empty())
+    return false;
+  DominatorTree DT(F);
+  PromoteMemToReg(Allocas, DT);
+  return true;
+}
+
 bool InstrumentParallel::runOnFunction(Function &F) {
   // This is required to prevent instrumenting call to __sword_init from within
   // the module constructor.
@@ -550,6 +779,7 @@ bool InstrumentParallel::runOnFunction(Function &F) {
   llvm::GlobalVariable *ompIndex = NULL;
   llvm::GlobalVariable *ompBarrierID = NULL;
   llvm::GlobalVariable *ompBuffer = NULL;
+  llvm::GlobalVariable *ompBlockItems = NULL;
   llvm::GlobalVariable *ompOffset = NULL;
   llvm::GlobalVariable *ompSpan = NULL;
   llvm::GlobalVariable *ompFileOffsetBegin = NULL;
@@ -588,6 +818,7 @@ bool InstrumentParallel::runOnFunction(Function &F) {
   ompIndex = M->getNamedGlobal("__sword_idx__");
   ompBarrierID = M->getNamedGlobal("__sword_bid__");
   ompBuffer = M->getNamedGlobal("__sword_buffer__");
+  ompBlockItems = M->getNamedGlobal("__sword_block_items__");
   ompOffset = M->getNamedGlobal("__sword_offset__");
   ompSpan = M->getNamedGlobal("__sword_span__");
   ompFileOffsetBegin = M->getNamedGlobal("__sword_file_offset_begin__");
@@ -607,6 +838,7 @@ bool InstrumentParallel::runOnFunction(Function &F) {
     TLS_DECLARE(ompIndex, IRB.getInt64Ty(), "__sword_idx__", Zero64); // uint64_t
     TLS_DECLARE(ompBarrierID, IRB.getInt64Ty(), "__sword_bid__", Zero64); // uint64_t
     TLS_DECLARE(ompBuffer, IRB.getInt8PtrTy(), "__sword_buffer__", nullptr); // char *
+    TLS_DECLARE(ompBlockItems, IRB.getInt64Ty(), "__sword_block_items__", nullptr); // uint64_t
     TLS_DECLARE(ompOffset, IRB.getInt32Ty(), "__sword_offset__", Zero32); // size_t
     TLS_DECLARE(ompSpan, IRB.getInt32Ty(), "__sword_span__", Zero32); // size_t
     TLS_DECLARE(ompFileOffsetBegin, IRB.getInt64Ty(), "__sword_file_offset_begin__", Zero64); // size_t
@@ -628,6 +860,7 @@ bool InstrumentParallel::runOnFunction(Function &F) {
   TLS_DECLARE_EXTERN(ompIndex, IRB.getInt64Ty(), "__sword_idx__"); // uint64_t
   TLS_DECLARE_EXTERN(ompBarrierID, IRB.getInt64Ty(), "__sword_bid__"); // uint64_t
   TLS_DECLARE_EXTERN(ompBuffer, IRB.getInt8PtrTy(), "__sword_buffer__"); // char *
+  TLS_DECLARE_EXTERN(ompBlockItems, IRB.getInt64Ty(), "__sword_block_items__"); // uint64_t
   TLS_DECLARE_EXTERN(ompOffset, IRB.getInt32Ty(), "__sword_offset__"); // size_t
   TLS_DECLARE_EXTERN(ompSpan, IRB.getInt32Ty(), "__sword_span__"); // size_t
   TLS_DECLARE_EXTERN(ompFileOffsetBegin, IRB.getInt64Ty(), "__sword_file_offset_begin__"); // size_t
@@ -692,6 +925,10 @@ bool InstrumentParallel::runOnFunction(Function &F) {
     IF = new_function;
  }
 
+  SwordTraceIndex = ompIndex;
+  SwordTraceBuffer = ompBuffer;
+  SwordTraceBlockItems = ompBlockItems;
+
   // Instrumentation
   initializeCallbacks(*IF->getParent());
   SmallVector<Instruction*, 8> RetVec;
@@ -706,6 +943,12 @@ bool InstrumentParallel::runOnFunction(Function &F) {
   const TargetLibraryInfo *TLI =
       &getAnalysis<TargetLibraryInfoWrapperPass>().getTLI();
 
+  // The pass runs before mem2reg, the induction variables of the loops are
+  // still in allocas where SCEV cannot follow them. Promoted allocas do not
+  // escape, so their accesses were not instrumented anyway.
+  if (ClLoopRanges)
+    Res |= promoteAllocas(*IF);
+
   // Traverse all instructions, collect loads/stores/returns, check for calls.
   for (auto &BB : *IF) {
     for (auto &Inst : BB) {
@@ -730,6 +973,12 @@ bool InstrumentParallel::runOnFunction(Function &F) {
   // FIXME: many of these accesses do not need to be checked for races
   // (e.g. variables that do not escape, etc).
 
+  // Accesses of innermost loops whose whole address sequence is known before
+  // the loop runs are recorded once, the others are left in AllLoadsAndStores.
+  if (ClLoopRanges)
+    Res |= instrumentLoopRanges(*IF, AllLoadsAndStores, DL,
+                                const_cast<TargetLibraryInfo &>(*TLI));
+
   // Instrument memory accesses only if we want to report bugs in the function.
   for (auto Inst : AllLoadsAndStores) {
     Res |= instrumentLoadOrStore(Inst, DL);
@@ -741,9 +990,123 @@ bool InstrumentParallel::runOnFunction(Function &F) {
     Res |= instrumentAtomic(Inst, DL);
   }
 
+  // The run-time records the source and destination of a memory intrinsic
+  // as one range each.
+  if (ClInstrumentMemIntrinsics) {
+    for (auto Inst : MemIntrinCalls) {
+      Res |= instrumentMemIntrinsic(Inst);
+    }
+  }
+
   return Res;
 }
 
+// The analyses are computed here rather than requested from the pass manager
+// because F may be the clone of the function being run on.
+bool InstrumentParallel::instrumentLoopRanges(
+    Function &F, SmallVectorImpl<Instruction *> &All, const DataLayout &DL,
+    TargetLibraryInfo &TLI) {
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+  if (LI.empty())
+    return false;
+  AssumptionCache AC(F);
+  ScalarEvolution SE(F, TLI, AC, DT, LI);
+  SCEVExpander Expander(SE, DL, "sword.range");
+  DenseMap<Loop *, bool> CallFree;
+
+  bool Res = false;
+  SmallVector<Instruction *, 8> Remaining;
+  for (Instruction *I : All) {
+    if (instrumentLoopRange(I, LI, SE, DT, Expander, CallFree, DL))
+      Res = true;
+    else
+      Remaining.push_back(I);
+  }
+  All.swap(Remaining);
+  return Res;
+}
+
+// Replaces the per-iteration instrumentation of I with a call in the loop
+// preheader when I runs once per iteration of an innermost loop, at an
+// address {Start,+,Stride} and with a trip count known on loop entry. The
+// loop must not contain calls, so that the lockset cannot change while it
+// runs. It exits at the latch, or at the header as loops that were not
+// rotated do; then the last iteration only runs the header.
+bool InstrumentParallel::instrumentLoopRange(
+    Instruction *I, LoopInfo &LI, ScalarEvolution &SE, DominatorTree &DT,
+    SCEVExpander &Expander, DenseMap<Loop *, bool> &CallFree,
+    const DataLayout &DL) {
+  Loop *L = LI.getLoopFor(I->getParent());
+  if (!L || !L->empty())
+    return false;
+  BasicBlock *Preheader = L->getLoopPreheader();
+  BasicBlock *Latch = L->getLoopLatch();
+  BasicBlock *Exiting = L->getExitingBlock();
+  if (!Preheader || !Latch || !Exiting ||
+      (Exiting != Latch && Exiting != L->getHeader()) ||
+      !DT.dominates(I->getParent(), Latch))
+    return false;
+
+  auto It = CallFree.find(L);
+  if (It == CallFree.end()) {
+    bool NoCalls = true;
+    for (BasicBlock *BB : L->blocks())
+      for (Instruction &Inst : *BB)
+        if ((isa<CallInst>(Inst) || isa<InvokeInst>(Inst)) &&
+            !isa<DbgInfoIntrinsic>(Inst))
+          NoCalls = false;
+    It = CallFree.insert(std::make_pair(L, NoCalls)).first;
+  }
+  if (!It->second)
+    return false;
+
+  bool IsWrite = isa<StoreInst>(*I);
+  Value *Addr = getPointerOperand(I);
+  if (Addr->isSwiftError())
+    return false;
+  int Idx = getMemoryAccessFuncIndex(Addr, DL);
+  if (Idx < 0)
+    return false;
+
+  const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Addr));
+  if (!AR || AR->getLoop() != L || !AR->isAffine())
+    return false;
+  const SCEVConstant *Step =
+      dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+  const SCEV *BackedgeTakenCount = SE.getBackedgeTakenCount(L);
+  if (!Step || isa<SCEVCouldNotCompute>(BackedgeTakenCount))
+    return false;
+  Type *Int64Ty = Type::getInt64Ty(I->getContext());
+  const SCEV *Count = SE.getZeroExtendExpr(BackedgeTakenCount, Int64Ty);
+  if (Exiting == Latch || I->getParent() == Exiting)
+    Count = SE.getAddExpr(Count, SE.getOne(Int64Ty));
+  const SCEV *Start = AR->getStart();
+  if (!isSafeToExpand(Start, SE) || !isSafeToExpand(Count, SE))
+    return false;
+
+  Instruction *InsertPt = Preheader->getTerminator();
+  IRBuilder<> IRB(InsertPt);
+  Value *Base = Expander.expandCodeFor(Start, IRB.getInt8PtrTy(), InsertPt);
+  Value *N = Expander.expandCodeFor(Count, Int64Ty, InsertPt);
+  Value *Stride = IRB.getInt64(Step->getAPInt().getSExtValue());
+  CallInst *Call;
+  if (ClSiteIds) {
+    Value *SiteId = getSiteId(I, Idx, IsWrite, InsertPt);
+    Call = IRB.CreateCall(SwordSiteRange, {Base, Stride, N, SiteId});
+  } else {
+    Call = IRB.CreateCall(IsWrite ? SwordWriteRange[Idx] : SwordReadRange[Idx],
+                          {Base, Stride, N});
+  }
+  // The pc recorded by the run-time is the one of the call.
+  Call->setDebugLoc(I->getDebugLoc());
+
+  if (IsWrite) NumInstrumentedWrites++;
+  else         NumInstrumentedReads++;
+  NumLoopRanges++;
+  return true;
+}
+
 bool InstrumentParallel::instrumentLoadOrStore(Instruction *I,
                                             const DataLayout &DL) {
   IRBuilder<> IRB(I);
@@ -766,6 +1129,19 @@ bool InstrumentParallel::instrumentLoadOrStore(Instruction *I,
       : cast<LoadInst>(I)->getAlignment();
   Type *OrigTy = cast<PointerType>(Addr->getType())->getElementType();
   const uint32_t TypeSize = DL.getTypeStoreSizeInBits(OrigTy);
+  Value *SiteId = ClSiteIds ? getSiteId(I, Idx, IsWrite) : nullptr;
+  if (ClInlineFastPath && instrumentInlineAccess(I, Addr, Idx, IsWrite, SiteId)) {
+    if (IsWrite) NumInstrumentedWrites++;
+    else         NumInstrumentedReads++;
+    return true;
+  }
+  if (SiteId) {
+    IRB.CreateCall(SwordSiteAccess,
+                   {IRB.CreatePointerCast(Addr, IRB.getInt8PtrTy()), SiteId});
+    if (IsWrite) NumInstrumentedWrites++;
+    else         NumInstrumentedReads++;
+    return true;
+  }
   Value *OnAccessFunc = nullptr;
   if (Alignment == 0 || Alignment >= 8 || (Alignment % (TypeSize / 8)) == 0)
     OnAccessFunc = IsWrite ? SwordWrite[Idx] : SwordRead[Idx];
@@ -777,6 +1153,88 @@ bool InstrumentParallel::instrumentLoadOrStore(Instruction *I,
   return true;
 }
 
+// Append the access to the thread-local trace buffer without leaving the
+// instrumented function:
+//
+//   idx = __sword_idx__; rec = __sword_buffer__ + idx * 16;
+//   rec = { data_access, size_type, addr, pc }; __sword_idx__ = ++idx;
+//   if (idx >= __sword_block_items__) __sword_flush_buffer();
+//
+// The pc is materialized with a rip-relative lea, so the fast path is only
+// available on x86-64; other targets keep calling __sword_readN/writeN.
+// With a site ID the record is { site_access, site, addr } and needs no pc.
+bool InstrumentParallel::instrumentInlineAccess(Instruction *I, Value *Addr,
+                                                int Idx, bool IsWrite,
+                                                Value *SiteId) {
+  Module *M = I->getModule();
+  if (!SiteId && Triple(M->getTargetTriple()).getArch() != Triple::x86_64)
+    return false;
+  if (!SwordTraceIndex || !SwordTraceBuffer || !SwordTraceBlockItems)
+    return false;
+
+  IRBuilder<> IRB(I);
+  Type *Int16PtrTy = IRB.getInt16Ty()->getPointerTo();
+  Type *Int32PtrTy = IRB.getInt32Ty()->getPointerTo();
+  Type *Int64PtrTy = IRB.getInt64Ty()->getPointerTo();
+
+  Value *Index = IRB.CreateLoad(SwordTraceIndex, "__sword_idx");
+  Value *Buffer = IRB.CreateLoad(SwordTraceBuffer, "__sword_buf");
+  Value *Record = IRB.CreateInBoundsGEP(
+      IRB.getInt8Ty(), Buffer, IRB.CreateMul(Index, IRB.getInt64(kTraceItemSize)));
+
+  if (SiteId) {
+    IRB.CreateAlignedStore(IRB.getInt8(kTraceItemSiteAccess), Record, 1);
+    IRB.CreateAlignedStore(
+        SiteId,
+        IRB.CreatePointerCast(
+            IRB.CreateConstInBoundsGEP1_64(Record, kTraceItemSiteOffset),
+            Int32PtrTy), 1);
+    IRB.CreateAlignedStore(
+        IRB.CreatePtrToInt(Addr, IRB.getInt64Ty()),
+        IRB.CreatePointerCast(
+            IRB.CreateConstInBoundsGEP1_64(Record, kTraceItemSiteAddressOffset),
+            Int64PtrTy), 1);
+  } else {
+    // Same encoding as Access::setData(): size in the high nibble, type in the
+    // low one. CallbackType data_access is 0.
+    uint8_t SizeType = (Idx << 4) | (IsWrite ? 1 : 0);
+    IRB.CreateAlignedStore(IRB.getInt8(0), Record, 1);
+    IRB.CreateAlignedStore(
+        IRB.getInt8(SizeType),
+        IRB.CreateConstInBoundsGEP1_64(Record, kTraceItemSizeTypeOffset), 1);
+    IRB.CreateAlignedStore(
+        IRB.CreatePtrToInt(Addr, IRB.getInt64Ty()),
+        IRB.CreatePointerCast(
+            IRB.CreateConstInBoundsGEP1_64(Record, kTraceItemAddressOffset),
+            Int64PtrTy), 1);
+
+    InlineAsm *ReadPC = InlineAsm::get(
+        FunctionType::get(IRB.getInt64Ty(), false), "leaq 0(%rip), $0", "=r",
+        /*hasSideEffects=*/true);
+    CallInst *PC = IRB.CreateCall(ReadPC);
+    PC->setDebugLoc(I->getDebugLoc());
+    Value *PCField = IRB.CreateConstInBoundsGEP1_64(Record, kTraceItemPCOffset);
+    IRB.CreateAlignedStore(IRB.CreateTrunc(PC, IRB.getInt32Ty()),
+                           IRB.CreatePointerCast(PCField, Int32PtrTy), 1);
+    IRB.CreateAlignedStore(
+        IRB.CreateTrunc(IRB.CreateLShr(PC, 32), IRB.getInt16Ty()),
+        IRB.CreatePointerCast(IRB.CreateConstInBoundsGEP1_64(PCField, 4),
+                              Int16PtrTy), 1);
+  }
+
+  Value *NextIndex = IRB.CreateAdd(Index, IRB.getInt64(1));
+  IRB.CreateStore(NextIndex, SwordTraceIndex);
+  Value *Full = IRB.CreateICmpUGE(
+      NextIndex, IRB.CreateLoad(SwordTraceBlockItems, "__sword_block_items"));
+  TerminatorInst *Then = SplitBlockAndInsertIfThen(
+      Full, I, false, MDBuilder(M->getContext()).createBranchWeights(1, 100000));
+  IRBuilder<> ThenIRB(Then);
+  ThenIRB.CreateCall(SwordFlushBuffer, {})->setDebugLoc(I->getDebugLoc());
+
+  NumInlinedAccesses++;
+  return true;
+}
+
 static ConstantInt *createOrdering(IRBuilder<> *IRB, AtomicOrdering ord) {
   uint32_t v = 0;
   switch (ord) {
@@ -794,14 +1252,9 @@ static ConstantInt *createOrdering(IRBuilder<> *IRB, AtomicOrdering ord) {
   return IRB->getInt32(v);
 }
 
-// If a memset intrinsic gets inlined by the code gen, we will miss races on it.
-// So, we either need to ensure the intrinsic is not inlined, or instrument it.
-// We do not instrument memset/memmove/memcpy intrinsics (too complicated),
-// instead we simply replace them with regular function calls, which are then
-// intercepted by the run-time.
-// Since sword is running after everyone else, the calls should not be
-// replaced back with intrinsics. If that becomes wrong at some point,
-// we will need to call e.g. __sword_memset to avoid the intrinsics.
+// Replaces a memset/memcpy/memmove intrinsic with a call to __sword_memset,
+// __sword_memcpy or __sword_memmove, which records the ranges it accesses
+// and then performs it, so the code gen cannot inline it out of sight.
 bool InstrumentParallel::instrumentMemIntrinsic(Instruction *I) {
   IRBuilder<> IRB(I);
   if (MemSetInst *M = dyn_cast<MemSetInst>(I)) {
@@ -818,8 +1271,11 @@ bool InstrumentParallel::instrumentMemIntrinsic(Instruction *I) {
          IRB.CreatePointerCast(M->getArgOperand(1), IRB.getInt8PtrTy()),
          IRB.CreateIntCast(M->getArgOperand(2), IntptrTy, false)});
     I->eraseFromParent();
+  } else {
+    return false;
   }
-  return false;
+  NumInstrumentedMemIntrinsics++;
+  return true;
 }
 
 static Value *createIntOrPtrToIntCast(Value *V, Type* Ty, IRBuilder<> &IRB) {
@@ -0,0 +1,223 @@
+//===-- sword_adapt.h ----------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Adaptive compression. The compression workers report every block they
+// write; every ADAPT_WINDOW blocks the controller looks at the backlog of
+// the job queues and at how much of the time of the workers was CPU time:
+//
+//  - a backlog with busy CPUs means compression is the bottleneck, the
+//    codec moves one step down the ladder (faster, down to raw blocks);
+//  - a backlog with idle CPUs means the workers wait for the disk, the
+//    codec moves one step up the ladder (higher ratio);
+//  - no backlog for a few windows moves one step up as well.
+//
+// The number of accesses per block is halved while the time to write a
+// block exceeds ADAPT_LATENCY_NS, and doubled back when it is well below.
+// Every decision is appended to ADAPT_FILE in the traces folder.
+//===----------------------------------------------------------------------===//
+
+#ifndef SWORD_ADAPT_H
+#define SWORD_ADAPT_H
+
+#include "sword_codec.h"
+#include "sword_common.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define ADAPT_FILE				"adaptfile"
+#define ADAPT_WINDOW			64
+// Mean queued blocks per block written, as a fraction of ring_depth.
+#define ADAPT_BACKLOG_HIGH		0.5
+#define ADAPT_BACKLOG_LOW		0.1
+// CPU time over wall time of the workers below which they wait for I/O.
+#define ADAPT_CPU_BOUND			0.5
+// Quiet windows before moving to a higher ratio.
+#define ADAPT_QUIET_WINDOWS		4
+#define ADAPT_LATENCY_NS		(100 * 1000 * 1000ULL)
+#define ADAPT_MIN_BLOCK_ITEMS	(NUM_OF_ACCESSES / 16)
+
+struct CodecSetting {
+  BlockCodec codec;
+  int level;
+};
+
+static uint64_t clock_ns(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+class AdaptiveController {
+ private:
+  bool enabled;
+  unsigned ring_depth;
+  // From the highest ratio to raw blocks.
+  std::vector<CodecSetting> ladder;
+  std::atomic<unsigned> step;
+  std::atomic<uint32_t> block_items;
+
+  std::mutex mtx; // window and log
+  uint64_t blocks;
+  uint64_t backlog;
+  uint64_t cpu_ns;
+  uint64_t wall_ns;
+  uint64_t in_bytes;
+  uint64_t out_bytes;
+  unsigned quiet;
+  uint64_t start_ns;
+  FILE *log;
+
+  void reset_window() {
+    blocks = backlog = cpu_ns = wall_ns = in_bytes = out_bytes = 0;
+  }
+
+  void decide() {
+    double mean_backlog = (double) backlog / blocks / ring_depth;
+    double cpu_ratio = wall_ns ? (double) cpu_ns / wall_ns : 1.0;
+    // Time to write a block, including the wait behind the queued ones.
+    uint64_t latency = (double) wall_ns / blocks * (1 + (double) backlog / blocks);
+    unsigned s = step.load(std::memory_order_relaxed);
+    uint32_t items = block_items.load(std::memory_order_relaxed);
+    const char *reason = NULL;
+
+    if(mean_backlog > ADAPT_BACKLOG_HIGH) {
+      quiet = 0;
+      if(cpu_ratio >= ADAPT_CPU_BOUND && s + 1 < ladder.size()) {
+        s++;
+        reason = "cpu-bound";
+      } else if(cpu_ratio < ADAPT_CPU_BOUND && s > 0) {
+        s--;
+        reason = "io-bound";
+      }
+    } else if(mean_backlog < ADAPT_BACKLOG_LOW) {
+      if(++quiet >= ADAPT_QUIET_WINDOWS && s > 0) {
+        s--;
+        quiet = 0;
+        reason = "idle";
+      }
+    } else {
+      quiet = 0;
+    }
+
+    if(latency > ADAPT_LATENCY_NS && items > ADAPT_MIN_BLOCK_ITEMS) {
+      items = std::max<uint32_t>(items / 2, ADAPT_MIN_BLOCK_ITEMS);
+      reason = reason ? reason : "latency";
+    } else if(latency < ADAPT_LATENCY_NS / 4 && items < NUM_OF_ACCESSES) {
+      items = std::min<uint32_t>(items * 2, NUM_OF_ACCESSES);
+      reason = reason ? reason : "latency";
+    }
+
+    if(!reason)
+      return;
+    decisions++;
+    step.store(s, std::memory_order_relaxed);
+    block_items.store(items, std::memory_order_relaxed);
+    if(log)
+      fprintf(log, "%lu,%s,%d,%u,%.3f,%.3f,%lu,%.3f,%s\n",
+              (clock_ns(CLOCK_MONOTONIC) - start_ns) / 1000000, codec_name(ladder[s].codec),
+              ladder[s].level, items, mean_backlog, cpu_ratio, latency / 1000,
+              in_bytes ? (double) out_bytes / in_bytes : 1.0, reason);
+  }
+
+ public:
+  // Number of changes of setting.
+  std::atomic<uint64_t> decisions;
+
+  AdaptiveController() : enabled(false), ring_depth(1), step(0), block_items(NUM_OF_ACCESSES),
+                         quiet(0), start_ns(0), log(NULL), decisions(0) {
+    reset_window();
+  }
+
+  // The ladder starts at the selected codec, or at lzo if the codec is not
+  // on the ladder.
+  void init(bool adaptive, BlockCodec codec, int level, unsigned depth, const std::string &path) {
+    enabled = adaptive;
+    ring_depth = depth;
+    ladder.clear();
+    ladder.push_back({ codec_tcgen, 0 });
+#ifdef ZSTD
+    ladder.push_back({ codec_zstd, 9 });
+    ladder.push_back({ codec_zstd, 1 });
+#endif
+    ladder.push_back({ codec_lzo, 0 });
+    ladder.push_back({ codec_lz4, 1 });
+    ladder.push_back({ codec_lz4, 16 });
+    ladder.push_back({ codec_none, 0 });
+    unsigned s = 0;
+    while(s < ladder.size() && ladder[s].codec != codec)
+      s++;
+    if(s == ladder.size()) {
+      s = 0;
+      while(ladder[s].codec != codec_lzo)
+        s++;
+    }
+    if(!enabled) {
+      // The selected codec, whatever it is.
+      ladder.assign(1, { codec, level });
+      s = 0;
+    } else if(level > 0) {
+      ladder[s].level = level;
+    }
+    step = s;
+    block_items = NUM_OF_ACCESSES;
+    start_ns = clock_ns(CLOCK_MONOTONIC);
+    if(enabled) {
+      std::string filename = path + "/" + ADAPT_FILE;
+      log = fopen(filename.c_str(), "w");
+      if(log)
+        fprintf(log, "#time_ms,codec,level,block_items,backlog,cpu_ratio,latency_us,ratio,reason\n");
+    }
+  }
+
+  CodecSetting setting() const {
+    return ladder[step.load(std::memory_order_relaxed)];
+  }
+
+  uint32_t items() const {
+    return block_items.load(std::memory_order_relaxed);
+  }
+
+  // Called by a compression worker for every block it wrote, queued is the
+  // number of jobs that were waiting behind it.
+  void observe(unsigned queued, uint64_t cpu, uint64_t wall, size_t in, size_t out) {
+    if(!enabled)
+      return;
+    std::unique_lock<std::mutex> lock(mtx);
+    blocks++;
+    backlog += queued;
+    cpu_ns += cpu;
+    wall_ns += wall;
+    in_bytes += in;
+    out_bytes += out;
+    if(blocks < ADAPT_WINDOW)
+      return;
+    decide();
+    reset_window();
+  }
+
+  void finalize() {
+    if(log)
+      fclose(log);
+    log = NULL;
+  }
+
+  bool isEnabled() const {
+    return enabled;
+  }
+};
+
+#endif  // SWORD_ADAPT_H
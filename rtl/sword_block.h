@@ -0,0 +1,280 @@
+//===-- sword_block.h ----------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Layout of a block before it is handed to the compressor. A columnar block
+// splits the trace items into streams so that the codec sees runs of
+// similar bytes:
+//
+//   tag | n | m | s | k | pc_len | addr_len    (tag is a byte, rest varints)
+//   type[n]                                   one byte per item
+//   size_type[s]                              one byte per data_access
+//   pc[k]                                     dictionary, zig-zag deltas
+//   code[m]   (pc_len bytes)                  dictionary index per access
+//   delta[m]  (addr_len bytes)                zig-zag delta from the previous
+//                                             address of the same pc
+//   payload[n - m]                            other items, as recorded
+//
+// m counts data_access and site_access items, the dictionary holds the pc
+// of the former and the site of the latter.
+//
+// If the columnar block would not be smaller, the items are stored raw
+// after the tag.
+//===----------------------------------------------------------------------===//
+
+#ifndef SWORD_BLOCK_H
+#define SWORD_BLOCK_H
+
+#include "sword_common.h"
+
+#include <string.h>
+
+enum BlockFormat {
+  block_raw = 0,
+  block_columnar
+};
+
+#define PAYLOAD_SIZE			sizeof(TraceItem::Data)
+// Largest encoded block: tag and raw items.
+#define ENCODED_LEN				(1 + BLOCK_SIZE)
+#define VARINT_MAX				10
+#define DICT_LOG_SIZE			16
+
+static inline unsigned char *put_varint(unsigned char *p, uint64_t v) {
+  while(v >= 0x80) {
+    *p++ = (unsigned char) (v | 0x80);
+    v >>= 7;
+  }
+  *p++ = (unsigned char) v;
+  return p;
+}
+
+static inline const unsigned char *get_varint(const unsigned char *p, const unsigned char *end, uint64_t *v) {
+  if(p < end && *p < 0x80) {
+    *v = *p;
+    return p + 1;
+  }
+  uint64_t r = 0;
+  for(unsigned shift = 0; p < end && shift < 64; shift += 7) {
+    unsigned char b = *p++;
+    r |= (uint64_t) (b & 0x7F) << shift;
+    if(!(b & 0x80)) {
+      *v = r;
+      return p;
+    }
+  }
+  return NULL;
+}
+
+static inline uint64_t zigzag(int64_t v) {
+  return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v) {
+  return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+static inline bool is_access(uint8_t type) {
+  return (type == data_access) || (type == site_access);
+}
+
+class BlockEncoder {
+ private:
+  // pc -> dictionary code, reset by bumping the generation.
+  uint64_t dict_pc[1 << DICT_LOG_SIZE];
+  uint32_t dict_code[1 << DICT_LOG_SIZE];
+  uint32_t dict_gen[1 << DICT_LOG_SIZE];
+  uint32_t generation;
+
+  uint64_t pcs[NUM_OF_ACCESSES];
+  uint64_t last_address[NUM_OF_ACCESSES];
+  unsigned char codes[NUM_OF_ACCESSES * VARINT_MAX];
+  unsigned char deltas[NUM_OF_ACCESSES * VARINT_MAX];
+
+  uint32_t lookup(uint64_t pc, uint32_t *k) {
+    size_t h = (pc * 0x9E3779B97F4A7C15ULL) >> (64 - DICT_LOG_SIZE);
+    while(dict_gen[h] == generation) {
+      if(dict_pc[h] == pc)
+        return dict_code[h];
+      h = (h + 1) & ((1 << DICT_LOG_SIZE) - 1);
+    }
+    dict_gen[h] = generation;
+    dict_pc[h] = pc;
+    dict_code[h] = *k;
+    pcs[*k] = pc;
+    last_address[*k] = 0;
+    return (*k)++;
+  }
+
+ public:
+  BlockEncoder() : generation(0) {
+    memset(dict_gen, 0, sizeof(dict_gen));
+  }
+
+  // Encodes n (at most NUM_OF_ACCESSES) items into dst, which holds
+  // ENCODED_LEN bytes. Returns the encoded size.
+  size_t encode(const TraceItem *items, size_t n, unsigned char *dst, BlockFormat format) {
+    if(format == block_columnar) {
+      size_t len = encode_columnar(items, n, dst);
+      if(len)
+        return len;
+    }
+    dst[0] = block_raw;
+    memcpy(dst + 1, items, n * sizeof(TraceItem));
+    return 1 + n * sizeof(TraceItem);
+  }
+
+  // Returns 0 if the columnar block would not be smaller than the raw one.
+  size_t encode_columnar(const TraceItem *items, size_t n, unsigned char *dst) {
+    if(++generation == 0) {
+      memset(dict_gen, 0, sizeof(dict_gen));
+      generation = 1;
+    }
+
+    uint32_t m = 0, sized = 0, k = 0;
+    unsigned char *c = codes, *d = deltas;
+    for(size_t i = 0; i < n; i++) {
+      uint64_t key, address;
+      if(items[i].getType() == data_access) {
+        key = items[i].data.access.getPC();
+        address = items[i].data.access.getAddress();
+        sized++;
+      } else if(items[i].getType() == site_access) {
+        key = items[i].data.site_access.getSite();
+        address = items[i].data.site_access.getAddress();
+      } else {
+        continue;
+      }
+      uint32_t code = lookup(key, &k);
+      c = put_varint(c, code);
+      d = put_varint(d, zigzag((int64_t) (address - last_address[code])));
+      last_address[code] = address;
+      m++;
+    }
+
+    size_t raw_len = 1 + n * sizeof(TraceItem);
+    size_t pc_len = c - codes, addr_len = d - deltas;
+    // Header and dictionary are bounded by VARINT_MAX per value.
+    if(1 + 6 * VARINT_MAX + n + sized + k * VARINT_MAX + pc_len + addr_len + (n - m) * PAYLOAD_SIZE >= raw_len)
+      return 0;
+
+    unsigned char *p = dst;
+    *p++ = block_columnar;
+    p = put_varint(p, n);
+    p = put_varint(p, m);
+    p = put_varint(p, sized);
+    p = put_varint(p, k);
+    p = put_varint(p, pc_len);
+    p = put_varint(p, addr_len);
+    for(size_t i = 0; i < n; i++)
+      *p++ = (unsigned char) items[i].getType();
+    for(size_t i = 0; i < n; i++)
+      if(items[i].getType() == data_access)
+        *p++ = items[i].data.access.getAccessSizeType();
+    uint64_t prev = 0;
+    for(uint32_t i = 0; i < k; i++) {
+      p = put_varint(p, zigzag((int64_t) (pcs[i] - prev)));
+      prev = pcs[i];
+    }
+    memcpy(p, codes, pc_len);
+    p += pc_len;
+    memcpy(p, deltas, addr_len);
+    p += addr_len;
+    for(size_t i = 0; i < n; i++) {
+      if(!is_access(items[i].getType())) {
+        memcpy(p, &items[i].data, PAYLOAD_SIZE);
+        p += PAYLOAD_SIZE;
+      }
+    }
+    return p - dst;
+  }
+};
+
+// Decodes a block of len bytes into items, which holds NUM_OF_ACCESSES
+// entries. Returns the number of items, or -1 if the block is malformed.
+static long decode_block(const unsigned char *src, size_t len, TraceItem *items) {
+  const unsigned char *end = src + len;
+  if(len == 0)
+    return -1;
+
+  if(src[0] == block_raw) {
+    size_t n = (len - 1) / sizeof(TraceItem);
+    if(n > NUM_OF_ACCESSES)
+      return -1;
+    memcpy((void *) items, src + 1, n * sizeof(TraceItem));
+    return n;
+  }
+  if(src[0] != block_columnar)
+    return -1;
+
+  uint64_t n, m, sized, k, pc_len, addr_len;
+  const unsigned char *p = src + 1;
+  if(!(p = get_varint(p, end, &n)) || !(p = get_varint(p, end, &m)) ||
+     !(p = get_varint(p, end, &sized)) || !(p = get_varint(p, end, &k)) ||
+     !(p = get_varint(p, end, &pc_len)) || !(p = get_varint(p, end, &addr_len)))
+    return -1;
+  if(n > NUM_OF_ACCESSES || m > n || sized > m || k > m ||
+     (size_t) (end - p) < n + sized + pc_len + addr_len + (n - m) * PAYLOAD_SIZE)
+    return -1;
+
+  const unsigned char *types = p;
+  const unsigned char *size_types = types + n;
+  const unsigned char *size_types_end = size_types + sized;
+  p = size_types_end;
+
+  static thread_local uint64_t pcs[NUM_OF_ACCESSES];
+  static thread_local uint64_t last_address[NUM_OF_ACCESSES];
+  uint64_t prev = 0, v;
+  for(uint64_t i = 0; i < k; i++) {
+    if(!(p = get_varint(p, end, &v)))
+      return -1;
+    prev += unzigzag(v);
+    pcs[i] = prev;
+    last_address[i] = 0;
+  }
+  const unsigned char *c = p;
+  const unsigned char *c_end = c + pc_len;
+  const unsigned char *d = c_end;
+  const unsigned char *d_end = d + addr_len;
+  const unsigned char *payload = d_end;
+  if(payload > end)
+    return -1;
+
+  for(uint64_t i = 0; i < n; i++) {
+    TraceItem &item = items[i];
+    item.setType((CallbackType) types[i]);
+    if(is_access(types[i])) {
+      uint64_t code, delta;
+      if(!(c = get_varint(c, c_end, &code)) || code >= k ||
+         !(d = get_varint(d, d_end, &delta)))
+        return -1;
+      uint64_t address = last_address[code] + unzigzag(delta);
+      last_address[code] = address;
+      if(types[i] == data_access) {
+        if(size_types == size_types_end)
+          return -1;
+        Access &a = item.data.access;
+        a.size_type = *size_types++;
+        a.address = address;
+        a.pc.num = pcs[code];
+      } else {
+        item.data.site_access = SiteAccess((uint32_t) pcs[code], address);
+      }
+    } else {
+      if(payload + PAYLOAD_SIZE > end)
+        return -1;
+      memcpy(&item.data, payload, PAYLOAD_SIZE);
+      payload += PAYLOAD_SIZE;
+    }
+  }
+  return n;
+}
+
+#endif  // SWORD_BLOCK_H
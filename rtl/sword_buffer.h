@@ -0,0 +1,129 @@
+//===-- sword_buffer.h ---------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Trace buffers. Every OMPT thread records into a ring of ring_depth
+// buffers: while it fills one, the others may be queued for compression.
+// A buffer is owned either by its thread (free or recording) or by the
+// compression pool (in flight), and the pool gives it back by setting
+// its state once the block has been written. Buffers are taken from and
+// returned to a process wide pool, so threads that come and go do not
+// allocate new ones.
+//===----------------------------------------------------------------------===//
+
+#ifndef SWORD_BUFFER_H
+#define SWORD_BUFFER_H
+
+#include "sword_common.h"
+
+#include <sched.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+enum BufferState {
+  buffer_free = 0,
+  buffer_recording,
+  buffer_in_flight
+};
+
+struct TraceBuffer {
+  std::vector<TraceItem> accesses;
+  std::atomic<int> state;
+
+  TraceBuffer() : accesses(NUM_OF_ACCESSES), state(buffer_free) {}
+
+  // Called by the compression pool when the block has been written.
+  void release() {
+    state.store(buffer_free, std::memory_order_release);
+  }
+};
+
+class BufferPool {
+ private:
+  std::mutex mtx;
+  std::vector<TraceBuffer *> buffers;
+
+ public:
+  TraceBuffer *get() {
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      if(!buffers.empty()) {
+        TraceBuffer *b = buffers.back();
+        buffers.pop_back();
+        return b;
+      }
+    }
+    return new TraceBuffer();
+  }
+
+  // The buffer must not be in flight.
+  void put(TraceBuffer *b) {
+    std::unique_lock<std::mutex> lock(mtx);
+    buffers.push_back(b);
+  }
+};
+
+class BufferRing {
+ private:
+  std::vector<TraceBuffer *> ring;
+  unsigned current;
+
+ public:
+  // Number of times the next buffer was still in flight.
+  uint64_t dry;
+  uint64_t blocks;
+
+  BufferRing(BufferPool *pool, unsigned depth) : current(0), dry(0), blocks(0) {
+    for(unsigned i = 0; i < depth; i++)
+      ring.push_back(pool->get());
+    ring[current]->state.store(buffer_recording, std::memory_order_relaxed);
+  }
+
+  TraceBuffer *get() {
+    return ring[current];
+  }
+
+  // Hands the current buffer over to the pool. This must happen before
+  // the block is queued: a worker may write it and release() the buffer
+  // before submit() returns.
+  TraceBuffer *hand_off() {
+    TraceBuffer *b = ring[current];
+    b->state.store(buffer_in_flight, std::memory_order_release);
+    blocks++;
+    return b;
+  }
+
+  // Moves to the next buffer once the current one has been handed off,
+  // waiting for it only if the whole ring is in flight.
+  TraceBuffer *next() {
+    current = (current + 1) % ring.size();
+    TraceBuffer *b = ring[current];
+    if(b->state.load(std::memory_order_acquire) != buffer_free) {
+      dry++;
+      while(b->state.load(std::memory_order_acquire) != buffer_free)
+        sched_yield();
+    }
+    b->state.store(buffer_recording, std::memory_order_relaxed);
+    return b;
+  }
+
+  // All the buffers must have been written.
+  void release(BufferPool *pool) {
+    for(TraceBuffer *b : ring) {
+      b->state.store(buffer_free, std::memory_order_relaxed);
+      pool->put(b);
+    }
+    ring.clear();
+  }
+};
+
+#endif  // SWORD_BUFFER_H
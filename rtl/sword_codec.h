@@ -0,0 +1,187 @@
+//===-- sword_codec.h ----------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Block codecs. All of them are compiled in (zstd if CMake found it), the
+// runtime compresses with the one selected in SWORD_OPTIONS and records it
+// in the header of every block, so the analysis picks the decoder per
+// block.
+//
+// tcgen is the trace-specific codec of sword_tcgen.h, it understands the
+// items of raw blocks only, so the runtime encodes raw blocks for it.
+//===----------------------------------------------------------------------===//
+
+#ifndef SWORD_CODEC_H
+#define SWORD_CODEC_H
+
+#include "lzo/minilzo.h"
+#include "lz4/lz4.h"
+#include "snappy/snappy.h"
+#include "sword_tcgen.h"
+
+#ifdef ZSTD
+#include <zstd.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+#define LZ4_DEFAULT_ACCELERATION	5
+#define ZSTD_DEFAULT_LEVEL			3
+
+enum BlockCodec {
+  codec_none = 0,
+  codec_lzo,
+  codec_snappy,
+  codec_lz4,
+  codec_zstd,
+  codec_tcgen,
+  NUM_CODECS
+};
+
+// Set by CMake from the COMPRESSION variable.
+#ifndef DEFAULT_CODEC
+#define DEFAULT_CODEC codec_lzo
+#endif
+
+static const char *codec_names[NUM_CODECS] = { "none", "lzo", "snappy", "lz4", "zstd", "tcgen" };
+
+static bool codec_available(unsigned codec) {
+#ifdef ZSTD
+  return codec < NUM_CODECS;
+#else
+  return codec < NUM_CODECS && codec != codec_zstd;
+#endif
+}
+
+static bool codec_parse(const std::string &name, BlockCodec *codec) {
+  for(unsigned c = 0; c < NUM_CODECS; c++) {
+    if(name == codec_names[c] && codec_available(c)) {
+      *codec = (BlockCodec) c;
+      return true;
+    }
+  }
+  return false;
+}
+
+static const char *codec_name(unsigned codec) {
+  return codec < NUM_CODECS ? codec_names[codec] : "unknown";
+}
+
+static bool codec_init() {
+  return lzo_init() == LZO_E_OK;
+}
+
+// Upper bound of the compressed size of len bytes, never less than len so
+// that a block that does not compress can be stored with codec_none.
+static size_t codec_bound(BlockCodec codec, size_t len) {
+  switch(codec) {
+  case codec_lzo:
+    return len + len / 16 + 64 + 3;
+  case codec_snappy:
+    return snappy::MaxCompressedLength(len);
+  case codec_lz4:
+    return LZ4_compressBound(len);
+#ifdef ZSTD
+  case codec_zstd:
+    return ZSTD_compressBound(len);
+#endif
+  case codec_tcgen:
+    // A block it does not shrink is stored with codec_none.
+    return len;
+  default:
+    return len;
+  }
+}
+
+// Compresses len bytes of src in dst, which holds codec_bound() bytes.
+// level is the LZ4 acceleration or the zstd level, 0 for the default.
+// Returns the compressed size, 0 on failure.
+static size_t codec_compress(BlockCodec codec, int level, const unsigned char *src, size_t len,
+                             unsigned char *dst, size_t capacity) {
+  switch(codec) {
+  case codec_none:
+    if(len > capacity)
+      return 0;
+    memcpy(dst, src, len);
+    return len;
+  case codec_lzo: {
+    thread_local lzo_align_t wrkmem[(LZO1X_1_MEM_COMPRESS + sizeof(lzo_align_t) - 1) / sizeof(lzo_align_t)];
+    lzo_uint out_len;
+    if(lzo1x_1_compress(src, len, dst, &out_len, wrkmem) != LZO_E_OK)
+      return 0;
+    return out_len;
+  }
+  case codec_snappy: {
+    size_t out_len;
+    snappy::RawCompress((const char *) src, len, (char *) dst, &out_len);
+    return out_len;
+  }
+  case codec_lz4: {
+    int ret = LZ4_compress_fast((const char *) src, (char *) dst, len, capacity,
+                                level > 0 ? level : LZ4_DEFAULT_ACCELERATION);
+    return ret > 0 ? ret : 0;
+  }
+#ifdef ZSTD
+  case codec_zstd: {
+    size_t ret = ZSTD_compress(dst, capacity, src, len, level > 0 ? level : ZSTD_DEFAULT_LEVEL);
+    return ZSTD_isError(ret) ? 0 : ret;
+  }
+#endif
+  case codec_tcgen:
+    return tcgen_compress(src, len, dst, capacity);
+  default:
+    return 0;
+  }
+}
+
+// Decompresses len bytes of src in dst, which holds capacity bytes.
+// Returns the decompressed size, -1 on failure.
+static long codec_decompress(unsigned codec, const unsigned char *src, size_t len,
+                             unsigned char *dst, size_t capacity) {
+  switch(codec) {
+  case codec_none:
+    if(len > capacity)
+      return -1;
+    memcpy(dst, src, len);
+    return len;
+  case codec_lzo: {
+    lzo_uint out_len = capacity;
+    if(lzo1x_decompress_safe(src, len, dst, &out_len, NULL) != LZO_E_OK)
+      return -1;
+    return out_len;
+  }
+  case codec_snappy: {
+    size_t out_len;
+    if(!snappy::GetUncompressedLength((const char *) src, len, &out_len) || out_len > capacity ||
+       !snappy::RawUncompress((const char *) src, len, (char *) dst))
+      return -1;
+    return out_len;
+  }
+  case codec_lz4: {
+    int ret = LZ4_decompress_safe((const char *) src, (char *) dst, len, capacity);
+    return ret >= 0 ? ret : -1;
+  }
+#ifdef ZSTD
+  case codec_zstd: {
+    size_t ret = ZSTD_decompress(dst, capacity, src, len);
+    return ZSTD_isError(ret) ? -1 : ret;
+  }
+#endif
+  case codec_tcgen:
+    return tcgen_decompress(src, len, dst, capacity);
+  default:
+    return -1;
+  }
+}
+
+#endif  // SWORD_CODEC_H
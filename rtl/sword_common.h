@@ -1,10 +1,6 @@
 #ifndef SWORD_COMMON_H
 #define SWORD_COMMON_H
 
-#ifdef LZO
-#include "lzo/minilzo.h"
-#endif
-
 #define PRIME 2654435761U
 
 #include <omp.h>
@@ -46,13 +42,6 @@ std::mutex smtx;
 #define DEBUG(stream, x)
 #endif
 
-#ifdef LZO
-#define HEAP_ALLOC(var,size) thread_local lzo_align_t __LZO_MMODEL      \
-  var [((size) + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t)]
-
-HEAP_ALLOC(wrkmem, LZO1X_1_MEM_COMPRESS);
-#endif
-
 #define SWORD_DATA 				"sword_data"
 #define OFFSET_SPAN_FORMAT		"%01d%01d"
 #define NUM_OF_ACCESSES			25000
@@ -124,6 +113,10 @@ struct __attribute__ ((__packed__)) Access {
     return address;
   }
 
+  void setAddress(size_t a) {
+    address = a;
+  }
+
   size_t getPC() const {
     return pc.num;
   }
@@ -143,6 +136,123 @@ std::size_t hash_value(Access const& a) {
   return val;
 }
 
+struct __attribute__ ((__packed__)) SiteAccess {
+ public:
+  uint32_t site;
+  size_t address;
+
+  SiteAccess() {
+    site = 0;
+    address = 0;
+  }
+
+  SiteAccess(uint32_t s, size_t a) {
+    site = s;
+    address = a;
+  }
+
+  uint32_t getSite() const {
+    return site;
+  }
+
+  size_t getAddress() const {
+    return address;
+  }
+
+  void setAddress(size_t a) {
+    address = a;
+  }
+};
+
+bool operator ==(const SiteAccess &a, const SiteAccess &b) {
+  return ((a.getSite() == b.getSite()) &&
+          (a.getAddress() == b.getAddress()));
+}
+
+std::size_t hash_value(SiteAccess const& a) {
+  std::size_t val { 0 };
+  boost::hash_combine(val, a.getAddress());
+  boost::hash_combine(val, a.getSite());
+  return val;
+}
+
+// Follows a data_access or site_access in the same block: that access is
+// the first of count accesses, stride bytes apart.
+struct __attribute__ ((__packed__)) AccessRun {
+ public:
+  int64_t stride;
+  uint32_t count;
+
+  AccessRun() {
+    stride = 0;
+    count = 0;
+  }
+
+  AccessRun(int64_t s, uint32_t c) {
+    stride = s;
+    count = c;
+  }
+
+  int64_t getStride() const {
+    return stride;
+  }
+
+  uint32_t getCount() const {
+    return count;
+  }
+};
+
+// Static access site emitted by InstrumentParallel (-sword-site-ids), the
+// size and type of a site_access are the ones of its site.
+struct SwordSite {
+  uint32_t line;
+  uint32_t column;
+  uint8_t size_type;
+  const char *file;
+  const char *function;
+};
+
+#define SITEFILE				"sitefile"
+#define SITEFILE_FORMAT			"%u,%u,%u,%u,%s,%s\n" // id,size_type,line,column,function,file
+// A race report carries the site ID of a site_access in place of its pc.
+#define SITE_PC_FLAG			(1ULL << 63)
+// Coverage of the sampled barrier intervals of a parallel region, one line
+// per barrier interval, in the report folder.
+#define COVERAGE_FILE			"coverage_"
+#define COVERAGE_FORMAT			"%lu,%lu,%lu\n" // bid,recorded,sampled_out
+
+// Record of a race report file: the number of races, then the races.
+struct RaceInfo {
+	uint64_t address;
+	uint8_t rw1;
+	uint8_t size1;
+	uint64_t pc1;
+	uint8_t rw2;
+	uint8_t size2;
+	uint64_t pc2;
+
+	RaceInfo(uint64_t address, uint8_t rw1, uint8_t size1, uint64_t pc1,
+			uint8_t rw2, uint8_t size2, uint64_t pc2) {
+		this->address = address;
+		this->rw1 = rw1;
+		this->size1 = size1;
+		this->pc1 = pc1;
+		this->rw2 = rw2;
+		this->size2 = size2;
+		this->pc2 = pc2;
+	}
+
+	RaceInfo() {
+		this->address = 0;
+		this->rw1 = 0;
+		this->size1 = 0;
+		this->pc1 = 0;
+		this->rw2 = 0;
+		this->size2 = 0;
+		this->pc2 = 0;
+	}
+};
+
 struct __attribute__ ((__packed__)) Parallel {
  private:
   ompt_id_t parallel_id;
@@ -350,7 +460,9 @@ enum CallbackType {
   task_create, // 8: Task: type and has dependences
   task_schedule, // 9: TaskCreate: type and has dependences
   task_dependence, // 10: TaskDependences: type and has dependences
-  os_label // 11: OffsetSpan: offset and span
+  os_label, // 11: OffsetSpan: offset and span
+  site_access, // 12: SiteAccess: site id and address
+  access_run // 13: AccessRun: stride and count of the previous access
 };
 
 struct TraceItem {
@@ -365,6 +477,16 @@ public:
     data.access = access;
   }
 
+  TraceItem(uint8_t type, const SiteAccess &site_access) {
+    item_type = type;
+    data.site_access = site_access;
+  }
+
+  TraceItem(uint8_t type, const AccessRun &access_run) {
+    item_type = type;
+    data.access_run = access_run;
+  }
+
   TraceItem(uint8_t type, const Parallel &parallel) {
     item_type = type;
     data.parallel = parallel;
@@ -383,9 +505,19 @@ public:
     return (CallbackType) item_type;
   }
 
+  // Only for data_access and site_access items.
+  void setAddress(size_t address) {
+    if(item_type == site_access)
+      data.site_access.setAddress(address);
+    else
+      data.access.setAddress(address);
+  }
+
   union Data {
     Data() {new(&access) Access();}
     struct Access access;
+    struct SiteAccess site_access;
+    struct AccessRun access_run;
     struct Parallel parallel;
     struct Work work;
     struct Master master;
@@ -404,6 +536,8 @@ bool operator==(TraceItem const& a, TraceItem const& b) {
   switch(a.getType()) {
   case data_access:
     return a.data.access == b.data.access;
+  case site_access:
+    return a.data.site_access == b.data.site_access;
   case mutex_acquired:
   case mutex_released:
     return a.data.mutex_region == b.data.mutex_region;
@@ -419,6 +553,9 @@ std::size_t hash_value(TraceItem const& a) {
   case data_access:
     boost::hash_combine(val, a.data.access);
     break;
+  case site_access:
+    boost::hash_combine(val, a.data.site_access);
+    break;
   case mutex_acquired:
   case mutex_released:
     boost::hash_combine(val, a.data.mutex_region);
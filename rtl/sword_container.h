@@ -0,0 +1,507 @@
+//===-- sword_container.h ------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Trace container: a single file per process that holds the blocks of all
+// the threads. A thread reserves extents of the file with an atomic bump of
+// its tail, preallocates them with fallocate and maps them, and its blocks
+// are compressed straight into the mapping, so threads never share a file
+// offset and there is no copy through stdio. Every block is a BlockHeader
+// followed by the compressed data, and the offsets recorded in the barrier
+// intervals are offsets in the stream of blocks of the thread, as they were
+// in its own datafile. A block that might not fit in the rest of an extent
+// goes to the next one, so extents can end with unused bytes.
+// The header of a block describes it without the footer, and its checksum
+// lets the analysis tell a corrupt or truncated trace from a valid one.
+//
+// At finalize the container gets a footer:
+//
+//   index[index_count]          BlockIndexEntry, per thread in stream order
+//   intervals[interval_count]   IntervalRecord, sorted by (pid, bid, tid)
+//   ContainerTrailer            last bytes of the file
+//
+// A thread records barrier interval 0 of a region twice, when its implicit
+// task begins and at the first barrier. The sort is stable, so records of
+// the same (pid, bid, tid) keep the order of the stream, and the analysis
+// keeps the last one, as it kept the last line of a metafile.
+//===----------------------------------------------------------------------===//
+
+#ifndef SWORD_CONTAINER_H
+#define SWORD_CONTAINER_H
+
+#include "sword_codec.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define CONTAINER_FILE			"tracefile"
+#define CONTAINER_MAGIC			"SWORDTRC"
+#define CONTAINER_END_MAGIC		"SWORDEND"
+#define CONTAINER_VERSION		4
+// Extents start after the header page, and are multiples of pages.
+#define CONTAINER_HEADER_SIZE	4096
+#define DEFAULT_EXTENT_SIZE		(64ULL << 20)
+#define BLOCK_MAGIC				"SWBK"
+
+struct __attribute__ ((__packed__)) ContainerHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+
+struct __attribute__ ((__packed__)) BlockHeader {
+  char magic[4];
+  uint8_t codec;            // BlockCodec
+  uint8_t reserved[3];
+  uint32_t tid;
+  uint32_t compressed_len;  // of the data after the header
+  uint32_t uncompressed_len;
+  uint32_t nitems;          // TraceItems in the block
+  uint64_t offset;          // in the stream of the thread
+  uint64_t first_item;      // index in the stream of the first TraceItem
+  uint32_t checksum;        // crc32 of the compressed data
+  uint32_t reserved2;
+};
+
+struct __attribute__ ((__packed__)) BlockIndexEntry {
+  uint32_t tid;
+  uint32_t reserved;
+  uint64_t offset;   // in the stream of the thread
+  uint64_t position; // in the container
+  uint64_t length;   // including the header
+};
+
+// Barrier interval of a thread: its blocks in [begin, end) of its stream.
+struct __attribute__ ((__packed__)) IntervalRecord {
+  uint64_t pid;  // parallel_id
+  uint64_t ppid; // parent_parallel_id
+  uint64_t bid;
+  uint64_t begin;
+  uint64_t end;
+  uint32_t tid;
+  uint32_t offset;
+  uint32_t span;
+  int32_t level;
+  uint64_t recorded;    // accesses, with sampling=1
+  uint64_t sampled_out; // accesses left out by the sampling
+
+  bool operator<(const IntervalRecord &r) const {
+    if(pid != r.pid)
+      return pid < r.pid;
+    if(bid != r.bid)
+      return bid < r.bid;
+    return tid < r.tid;
+  }
+};
+
+// Orders the intervals by (pid, bid) only, to look a barrier interval up.
+struct IntervalKeyLess {
+  bool operator()(const IntervalRecord &r, const std::pair<uint64_t, uint64_t> &key) const {
+    return r.pid < key.first || (r.pid == key.first && r.bid < key.second);
+  }
+  bool operator()(const std::pair<uint64_t, uint64_t> &key, const IntervalRecord &r) const {
+    return key.first < r.pid || (key.first == r.pid && key.second < r.bid);
+  }
+};
+
+// Orders the index by (tid, offset), the blocks of a thread in stream order.
+struct BlockKeyLess {
+  bool operator()(const BlockIndexEntry &a, const BlockIndexEntry &b) const {
+    return a.tid < b.tid || (a.tid == b.tid && a.offset < b.offset);
+  }
+  bool operator()(const BlockIndexEntry &e, const std::pair<unsigned, uint64_t> &key) const {
+    return e.tid < key.first || (e.tid == key.first && e.offset < key.second);
+  }
+};
+
+struct __attribute__ ((__packed__)) ContainerTrailer {
+  uint64_t index_position;
+  uint64_t index_count;
+  uint64_t interval_position;
+  uint64_t interval_count;
+  char magic[8];
+};
+
+static bool pwrite_all(int fd, const void *data, size_t len, uint64_t position) {
+  const char *p = (const char *) data;
+  while(len > 0) {
+    ssize_t ret = pwrite(fd, p, len, position);
+    if(ret < 0) {
+      if(errno == EINTR)
+        continue;
+      return false;
+    }
+    p += ret;
+    len -= ret;
+    position += ret;
+  }
+  return true;
+}
+
+// zlib's crc32 takes at most 4 GB at a time.
+static uint32_t block_checksum(const unsigned char *data, size_t len) {
+  uLong crc = crc32(0L, Z_NULL, 0);
+  while(len > 0) {
+    uInt n = std::min<size_t>(len, 1u << 30);
+    crc = crc32(crc, data, n);
+    data += n;
+    len -= n;
+  }
+  return crc;
+}
+
+static uint64_t round_to_pages(uint64_t size) {
+  uint64_t page = sysconf(_SC_PAGESIZE);
+  return (size + page - 1) / page * page;
+}
+
+// Blocks and barrier intervals of one thread, written by the compression
+// worker of the thread in the order the thread queued them.
+struct TraceStream {
+  unsigned tid;
+  unsigned char *extent; // mapping of the current extent
+  uint64_t extent_begin;
+  uint64_t extent_position;
+  uint64_t extent_end;
+  uint64_t items; // TraceItems written so far
+  std::vector<BlockIndexEntry> index;
+  std::vector<IntervalRecord> intervals;
+
+  TraceStream(unsigned t) : tid(t), extent(NULL), extent_begin(0), extent_position(0), extent_end(0), items(0) {}
+
+  void interval(uint64_t pid, uint64_t ppid, uint64_t bid, unsigned offset,
+                unsigned span, int level, uint64_t begin, uint64_t end,
+                uint64_t recorded, uint64_t sampled_out) {
+    intervals.push_back({ pid, ppid, bid, begin, end, tid, offset, span, level, recorded, sampled_out });
+  }
+
+  void unmap() {
+    if(extent)
+      munmap(extent, extent_end - extent_begin);
+    extent = NULL;
+  }
+};
+
+class TraceContainer {
+ private:
+  int fd;
+  uint64_t extent_size;
+  std::atomic<uint64_t> tail;
+  std::mutex mtx;
+  std::vector<TraceStream *> streams;
+
+ public:
+  std::string filename;
+
+  TraceContainer() : fd(-1), extent_size(DEFAULT_EXTENT_SIZE), tail(CONTAINER_HEADER_SIZE) {}
+
+  bool open(const std::string &path, uint64_t extent) {
+    filename = path + "/" + CONTAINER_FILE;
+    extent_size = round_to_pages(extent);
+    tail = round_to_pages(CONTAINER_HEADER_SIZE);
+    fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+      return false;
+    ContainerHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CONTAINER_MAGIC, sizeof(header.magic));
+    header.version = CONTAINER_VERSION;
+    return pwrite_all(fd, &header, sizeof(header), 0);
+  }
+
+  TraceStream *stream(unsigned tid) {
+    TraceStream *s = new TraceStream(tid);
+    std::unique_lock<std::mutex> lock(mtx);
+    streams.push_back(s);
+    return s;
+  }
+
+  // Returns a window of len bytes at the end of the stream to write the
+  // data of the next block in, after room for its header, or NULL if a new
+  // extent cannot be allocated.
+  unsigned char *reserve(TraceStream *s, size_t len) {
+    len += sizeof(BlockHeader);
+    if(s->extent_position + len > s->extent_end) {
+      s->unmap();
+      // Without an extent until the next one is mapped, so that the next
+      // reserve() retries if this one fails.
+      s->extent_begin = s->extent_position = s->extent_end = 0;
+      uint64_t size = std::max<uint64_t>(extent_size, round_to_pages(len));
+      uint64_t begin = tail.fetch_add(size);
+      // posix_fallocate falls back to writing the blocks if the file
+      // system does not support fallocate, the mapping needs them.
+      if((errno = posix_fallocate(fd, begin, size)) != 0)
+        return NULL;
+      void *extent = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, begin);
+      if(extent == MAP_FAILED)
+        return NULL;
+      s->extent = (unsigned char *) extent;
+      s->extent_begin = begin;
+      s->extent_position = begin;
+      s->extent_end = begin + size;
+    }
+    return s->extent + (s->extent_position - s->extent_begin) + sizeof(BlockHeader);
+  }
+
+  // Appends the first len bytes of the window as a block of nitems items,
+  // *offset is the end of the stream.
+  void commit(TraceStream *s, BlockCodec codec, size_t len, size_t uncompressed_len,
+              size_t nitems, size_t *offset) {
+    unsigned char *block = s->extent + (s->extent_position - s->extent_begin);
+    BlockHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BLOCK_MAGIC, sizeof(header.magic));
+    header.codec = codec;
+    header.tid = s->tid;
+    header.compressed_len = len;
+    header.uncompressed_len = uncompressed_len;
+    header.nitems = nitems;
+    header.offset = *offset;
+    header.first_item = s->items;
+    header.checksum = block_checksum(block + sizeof(BlockHeader), len);
+    memcpy(block, &header, sizeof(header));
+
+    len += sizeof(BlockHeader);
+    s->index.push_back({ s->tid, 0, *offset, s->extent_position, len });
+    s->extent_position += len;
+    s->items += nitems;
+    *offset += len;
+  }
+
+  // All the blocks must have been written.
+  bool finalize() {
+    ContainerTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    uint64_t position = tail.load();
+    trailer.index_position = position;
+    std::vector<IntervalRecord> intervals;
+    for(TraceStream *s : streams) {
+      s->unmap();
+      if(!pwrite_all(fd, s->index.data(), s->index.size() * sizeof(BlockIndexEntry), position))
+        return false;
+      position += s->index.size() * sizeof(BlockIndexEntry);
+      trailer.index_count += s->index.size();
+      intervals.insert(intervals.end(), s->intervals.begin(), s->intervals.end());
+    }
+    // Stable: the last record of a (pid, bid, tid) must stay the last one.
+    std::stable_sort(intervals.begin(), intervals.end());
+    trailer.interval_position = position;
+    trailer.interval_count = intervals.size();
+    if(!pwrite_all(fd, intervals.data(), intervals.size() * sizeof(IntervalRecord), position))
+      return false;
+    position += intervals.size() * sizeof(IntervalRecord);
+    memcpy(trailer.magic, CONTAINER_END_MAGIC, sizeof(trailer.magic));
+    if(!pwrite_all(fd, &trailer, sizeof(trailer), position))
+      return false;
+    // Drop the unused tails of the last extents.
+    if(ftruncate(fd, position + sizeof(trailer)) != 0)
+      return false;
+    return close(fd) == 0;
+  }
+};
+
+// Read side, used by the analysis. The whole container is mapped, the
+// blocks are decompressed straight from the mapping.
+// sword-analysisd reads the container of a running program with
+// open_live(): there is no footer yet, the index grows with the blocks that
+// the threads publish and the mapping with the file.
+class ContainerReader {
+ private:
+  const unsigned char *mapping;
+  size_t size;
+  int live_fd;
+  bool sorted; // index by BlockKeyLess
+
+ public:
+  std::vector<BlockIndexEntry> index;
+  // In the mapping, sorted by (pid, bid, tid).
+  const IntervalRecord *intervals;
+  size_t interval_count;
+
+  ContainerReader() : mapping(NULL), size(0), live_fd(-1), sorted(false), intervals(NULL), interval_count(0) {}
+
+  ~ContainerReader() {
+    if(mapping)
+      munmap((void *) mapping, size);
+    if(live_fd >= 0)
+      close(live_fd);
+  }
+
+  bool open(const std::string &path) {
+    int fd = ::open((path + "/" + CONTAINER_FILE).c_str(), O_RDONLY);
+    if(fd < 0)
+      return false;
+    off_t end = lseek(fd, 0, SEEK_END);
+    if(end < (off_t) (CONTAINER_HEADER_SIZE + sizeof(ContainerTrailer))) {
+      close(fd);
+      return false;
+    }
+    void *m = mmap(NULL, end, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(m == MAP_FAILED)
+      return false;
+    mapping = (const unsigned char *) m;
+    size = end;
+    // Every thread reads its blocks in stream order.
+    madvise(m, size, MADV_SEQUENTIAL);
+
+    ContainerHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    if(memcmp(header.magic, CONTAINER_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version != CONTAINER_VERSION)
+      return false;
+
+    ContainerTrailer trailer;
+    memcpy(&trailer, mapping + size - sizeof(trailer), sizeof(trailer));
+    if(memcmp(trailer.magic, CONTAINER_END_MAGIC, sizeof(trailer.magic)) != 0 ||
+       trailer.index_position + trailer.index_count * sizeof(BlockIndexEntry) > size ||
+       trailer.interval_position + trailer.interval_count * sizeof(IntervalRecord) > size)
+      return false;
+    const BlockIndexEntry *entries = (const BlockIndexEntry *) (mapping + trailer.index_position);
+    index.assign(entries, entries + trailer.index_count);
+    // The threads are in the order of their streams, not of their ids.
+    std::stable_sort(index.begin(), index.end(), BlockKeyLess());
+    sorted = true;
+    intervals = (const IntervalRecord *) (mapping + trailer.interval_position);
+    interval_count = trailer.interval_count;
+    return true;
+  }
+
+  bool open_live(const std::string &path) {
+    live_fd = ::open((path + "/" + CONTAINER_FILE).c_str(), O_RDWR);
+    if(live_fd < 0)
+      return false;
+    ContainerHeader header;
+    if(pread(live_fd, &header, sizeof(header), 0) != sizeof(header) ||
+       memcmp(header.magic, CONTAINER_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version != CONTAINER_VERSION)
+      return false;
+    return remap();
+  }
+
+  // Maps the file as it is now, after the blocks published so far.
+  bool remap() {
+    off_t end = lseek(live_fd, 0, SEEK_END);
+    if(end <= (off_t) size)
+      return end >= 0;
+    if(mapping)
+      munmap((void *) mapping, size);
+    void *m = mmap(NULL, end, PROT_READ, MAP_SHARED, live_fd, 0);
+    if(m == MAP_FAILED) {
+      mapping = NULL;
+      size = 0;
+      return false;
+    }
+    mapping = (const unsigned char *) m;
+    size = end;
+    return true;
+  }
+
+  void add(const BlockIndexEntry &e) {
+    index.push_back(e);
+    sorted = false;
+  }
+
+  // Drops the blocks of thread tid in [begin, end) of its stream from the
+  // index, and with punch their pages from the file.
+  void release(unsigned tid, uint64_t begin, uint64_t end, bool punch) {
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t run_begin = 0;
+    uint64_t run_end = 0;
+    std::vector<BlockIndexEntry>::iterator out = index.begin();
+    for(const BlockIndexEntry &e : index) {
+      if(e.tid != tid || e.offset < begin || e.offset >= end) {
+        *out++ = e;
+        continue;
+      }
+      if(e.position != run_end) {
+        punch_pages(run_begin, run_end, page, punch);
+        run_begin = e.position;
+      }
+      run_end = e.position + e.length;
+    }
+    punch_pages(run_begin, run_end, page, punch);
+    index.erase(out, index.end());
+  }
+
+  // Only whole pages, the others hold blocks of the next interval.
+  void punch_pages(uint64_t begin, uint64_t end, uint64_t page, bool punch) {
+    begin = (begin + page - 1) / page * page;
+    end = end / page * page;
+    if(punch && live_fd >= 0 && end > begin)
+      fallocate(live_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, begin, end - begin);
+  }
+
+  // Intervals of all the threads in barrier interval bid of region pid.
+  std::pair<const IntervalRecord *, const IntervalRecord *> find(uint64_t pid, uint64_t bid) const {
+    return std::equal_range(intervals, intervals + interval_count,
+                            std::make_pair(pid, bid), IntervalKeyLess());
+  }
+
+  // Blocks of thread tid in [begin, end) of its stream, in stream order.
+  std::vector<BlockIndexEntry> blocks(unsigned tid, uint64_t begin, uint64_t end) const {
+    std::vector<BlockIndexEntry> result;
+    if(sorted) {
+      std::vector<BlockIndexEntry>::const_iterator e =
+        std::lower_bound(index.begin(), index.end(), std::make_pair(tid, begin), BlockKeyLess());
+      for(; e != index.end() && e->tid == tid && e->offset < end; ++e)
+        result.push_back(*e);
+      return result;
+    }
+    for(const BlockIndexEntry &e : index)
+      if(e.tid == tid && e.offset >= begin && e.offset < end)
+        result.push_back(e);
+    return result;
+  }
+
+  // Asks the kernel for the pages of the block, ahead of block().
+  void prefetch(const BlockIndexEntry &e) const {
+    if(e.position + e.length > size)
+      return;
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t begin = e.position / page * page;
+    madvise((void *) (mapping + begin), e.position + e.length - begin, MADV_WILLNEED);
+  }
+
+  // TraceItems of the block in its header, unchecked, 0 if it is truncated.
+  uint32_t items(const BlockIndexEntry &e) const {
+    if(e.position + sizeof(BlockHeader) > size)
+      return 0;
+    return ((const BlockHeader *) (mapping + e.position))->nitems;
+  }
+
+  // The header of the block, or NULL if the block is truncated or does not
+  // match its index entry and its checksum. The data follows the header.
+  const BlockHeader *block(const BlockIndexEntry &e) const {
+    if(e.position + e.length > size || e.length < sizeof(BlockHeader))
+      return NULL;
+    const BlockHeader *h = (const BlockHeader *) (mapping + e.position);
+    if(memcmp(h->magic, BLOCK_MAGIC, sizeof(h->magic)) != 0 || h->tid != e.tid ||
+       h->offset != e.offset || h->compressed_len + sizeof(BlockHeader) != e.length ||
+       block_checksum((const unsigned char *) (h + 1), h->compressed_len) != h->checksum)
+      return NULL;
+    return h;
+  }
+};
+
+#endif  // SWORD_CONTAINER_H
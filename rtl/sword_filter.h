@@ -0,0 +1,90 @@
+//===-- sword_filter.h ---------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Small, lossy filter of the accesses recorded in the current block. It is
+// a set-associative cache of (address, size_type, pc) indexed by a single
+// multiply-shift hash and sized to stay in L1. A conflict evicts the older
+// entry, so a duplicate may be recorded again; a new access is never
+// dropped because the whole key is compared.
+//===----------------------------------------------------------------------===//
+
+#ifndef SWORD_FILTER_H
+#define SWORD_FILTER_H
+
+#include "sword_common.h"
+
+#include <string.h>
+
+// 1024 entries of 16 bytes: 16KB, half of a typical L1 data cache.
+#define FILTER_LOG_ENTRIES		10
+
+template<unsigned LOG_SETS, unsigned WAYS>
+class AccessFilter {
+ private:
+  struct Entry {
+    uint64_t address;
+    uint64_t tag; // pc in the upper 56 bits, size_type in the lower 8
+  };
+
+  Entry entries[(1 << LOG_SETS) * WAYS];
+
+ public:
+  static inline uint64_t tag_of(const Access &a) {
+    return (a.getPC() << 8) | a.getAccessSizeType();
+  }
+
+  // The tag is rotated so that its varying low bits (pc and size_type) do
+  // not cancel out the varying low bits of the address before the multiply.
+  static inline size_t set_of(uint64_t address, uint64_t tag) {
+    uint64_t key = address ^ ((tag << 32) | (tag >> 32));
+    return (key * 0x9E3779B97F4A7C15ULL) >> (64 - LOG_SETS);
+  }
+
+  void reserve(size_t) {}
+
+  void clear() {
+    memset(entries, 0, sizeof(entries));
+  }
+
+  // Returns true if the access was not in the filter, i.e. it has to be
+  // recorded.
+  bool check_insert(const Access &a) {
+    return check_insert(a.address, tag_of(a));
+  }
+
+  // size_type 0xFF does not exist, so sites never match pcs.
+  bool check_insert(const SiteAccess &a) {
+    return check_insert(a.address, ((uint64_t) a.site << 8) | 0xFF);
+  }
+
+  bool check_insert(uint64_t address, uint64_t tag) {
+    Entry *set = &entries[set_of(address, tag) * WAYS];
+
+    for(unsigned w = 0; w < WAYS; w++) {
+      if((set[w].address == address) && (set[w].tag == tag))
+        return false;
+    }
+    for(unsigned w = WAYS - 1; w > 0; w--)
+      set[w] = set[w - 1];
+    set[0].address = address;
+    set[0].tag = tag;
+    return true;
+  }
+
+  static constexpr size_t footprint() {
+    return sizeof(Entry) * (1 << LOG_SETS) * WAYS;
+  }
+};
+
+typedef AccessFilter<FILTER_LOG_ENTRIES, 1> direct_filter;
+typedef AccessFilter<FILTER_LOG_ENTRIES - 1, 2> twoway_filter;
+
+#endif  // SWORD_FILTER_H
@@ -0,0 +1,174 @@
+//===-- sword_filter_bench.cc ----------------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Compares the duplicate filters available to SAVE_ACCESS (see the DEDUP
+// CMake variable) on synthetic access streams. For every filter it prints
+// the nanoseconds spent per access, the number of records that would be written
+// and how many of them are duplicates of a record already in the same block.
+//===----------------------------------------------------------------------===//
+
+#include "sword_common.h"
+#include "sword_filter.h"
+#include "sword_hashset.h"
+
+#include <chrono>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#define SET_SIZE 87382
+
+typedef emilib::HashSet<uint64_t, NUM_OF_ACCESSES> hash_set;
+
+struct HashSetFilter {
+  hash_set set;
+
+  HashSetFilter() { set.reserve(SET_SIZE); }
+  void clear() { set.clear(); }
+  bool check_insert(const Access &a) {
+    return set.check_insert(hash_value(TraceItem(data_access, a)));
+  }
+  static size_t footprint() {
+    // States and keys of the reserved buckets.
+    size_t buckets = 4;
+    while(buckets < SET_SIZE + SET_SIZE / 2 + 1) buckets *= 2;
+    return buckets * (sizeof(uint64_t) + sizeof(int));
+  }
+};
+
+struct AccessKeyHash {
+  size_t operator()(const Access &a) const { return hash_value(a); }
+};
+
+// 5-point stencil sweep over a 2D grid of doubles: every element is read
+// by five different pcs, neighbours are reused across rows.
+static std::vector<Access> stencil_stream(size_t n) {
+  const size_t cols = 1024;
+  const size_t base = 0x10000000;
+  std::vector<Access> stream;
+  stream.reserve(n);
+  for(size_t i = 1; stream.size() < n; i++) {
+    for(size_t j = 1; j < cols - 1 && stream.size() < n; j++) {
+      size_t c = base + (i * cols + j) * 8;
+      stream.push_back(Access(size8, unsafe_read, c, 0x401000));
+      stream.push_back(Access(size8, unsafe_read, c - 8, 0x401010));
+      stream.push_back(Access(size8, unsafe_read, c + 8, 0x401020));
+      stream.push_back(Access(size8, unsafe_read, c - cols * 8, 0x401030));
+      stream.push_back(Access(size8, unsafe_read, c + cols * 8, 0x401040));
+      stream.push_back(Access(size8, unsafe_write, c + 0x8000000, 0x401050));
+    }
+  }
+  stream.resize(n);
+  return stream;
+}
+
+// Small working set revisited over and over, e.g. a reduction variable and
+// a lookup table.
+static std::vector<Access> hot_stream(size_t n) {
+  std::mt19937_64 gen(42);
+  std::uniform_int_distribution<size_t> idx(0, 63);
+  std::vector<Access> stream;
+  stream.reserve(n);
+  for(size_t i = 0; i < n; i++)
+    stream.push_back(Access(size4, (i & 1) ? unsafe_write : unsafe_read,
+                            0x20000000 + idx(gen) * 4, 0x402000 + (i & 3) * 16));
+  return stream;
+}
+
+// Uniformly random addresses over 64MB: almost no duplicates.
+static std::vector<Access> random_stream(size_t n) {
+  std::mt19937_64 gen(7);
+  std::uniform_int_distribution<size_t> idx(0, (64 << 20) / 8);
+  std::vector<Access> stream;
+  stream.reserve(n);
+  for(size_t i = 0; i < n; i++)
+    stream.push_back(Access(size8, unsafe_read, 0x30000000 + idx(gen) * 8, 0x403000));
+  return stream;
+}
+
+// The filter is cleared whenever NUM_OF_ACCESSES records have been
+// written, as DUMP_TO_FILE does.
+template<typename Filter>
+static size_t run_filter(Filter &filter, const std::vector<Access> &stream) {
+  size_t recorded = 0, idx = 0;
+  filter.clear();
+  for(const Access &a : stream) {
+    if(filter.check_insert(a)) {
+      recorded++;
+      if(++idx == NUM_OF_ACCESSES) {
+        idx = 0;
+        filter.clear();
+      }
+    }
+  }
+  return recorded;
+}
+
+template<typename Filter>
+static size_t count_duplicates(Filter &filter, const std::vector<Access> &stream) {
+  std::unordered_set<Access, AccessKeyHash> block;
+  size_t duplicates = 0, idx = 0;
+  filter.clear();
+  for(const Access &a : stream) {
+    if(filter.check_insert(a)) {
+      if(!block.insert(a).second)
+        duplicates++;
+      if(++idx == NUM_OF_ACCESSES) {
+        idx = 0;
+        filter.clear();
+        block.clear();
+      }
+    }
+  }
+  return duplicates;
+}
+
+template<typename Filter>
+static void bench(const char *name, Filter &filter, const std::vector<Access> &stream) {
+  const int rounds = 5;
+  double best = 0;
+  size_t recorded = 0;
+  for(int r = 0; r < rounds; r++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    recorded = run_filter(filter, stream);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if(r == 0 || ns < best)
+      best = ns;
+  }
+  size_t duplicates = count_duplicates(filter, stream);
+  printf("  %-10s %10zu B %10.2f %12zu %12zu\n", name, Filter::footprint(),
+         best / stream.size(), recorded, duplicates);
+}
+
+static void bench_stream(const char *name, const std::vector<Access> &stream) {
+  static HashSetFilter hash_filter;
+  static direct_filter direct;
+  static twoway_filter twoway;
+
+  printf("%s (%zu accesses)\n", name, stream.size());
+  printf("  %-10s %12s %10s %12s %12s\n", "filter", "footprint", "ns/acc", "recorded", "duplicates");
+  bench("fast_set", hash_filter, stream);
+  bench("direct", direct, stream);
+  bench("2-way", twoway, stream);
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  size_t n = 10000000;
+  if(argc > 1)
+    n = strtoull(argv[1], NULL, 0);
+
+  bench_stream("stencil", stencil_stream(n));
+  bench_stream("hot", hot_stream(n));
+  bench_stream("random", random_stream(n));
+
+  return 0;
+}
@@ -1,23 +1,112 @@
 #ifndef SWORD_FLAGS_H
 #define SWORD_FLAGS_H
 
+#include "sword_block.h"
+#include "sword_container.h"
+#include "sword_inprocess.h"
+#include "sword_sampling.h"
+
+#include <sstream>
 #include <string>
+#include <vector>
+
+#define DEFAULT_COMPRESSION_THREADS	2
+#define DEFAULT_RING_DEPTH		4
+#define MAX_RING_DEPTH			16
 
+// SWORD_OPTIONS is a space separated list of option=value pairs, e.g.
+// SWORD_OPTIONS="traces_path=/tmp/data compression_threads=4 compression_cpus=4,5,6,7"
 class SwordFlags {
  public:
   std::string traces_path;
-  
- SwordFlags(const char *env) : traces_path("./sword_data") {
+  unsigned compression_threads;
+  std::vector<int> compression_cpus;
+  unsigned ring_depth;
+  BlockFormat block_format;
+  bool access_runs;
+  uint64_t extent_size; // in bytes, the option is in MB
+  BlockCodec codec;
+  int codec_level;      // 0 for the default of the codec
+  bool adaptive;
+  bool sampling;
+  uint32_t sampling_period; // largest sampling period, a power of 2
+  bool online;
+  bool online_traces;
+  std::string online_cpus;
+  std::string report_path;
+  bool inprocess;
+  unsigned inprocess_threads;
+  std::vector<int> inprocess_cpus;
+  uint64_t inprocess_memory; // in bytes, the option is in MB
+
+ SwordFlags(const char *env) : traces_path("./sword_data"),
+    compression_threads(DEFAULT_COMPRESSION_THREADS), ring_depth(DEFAULT_RING_DEPTH),
+    block_format(block_columnar), access_runs(true),
+    extent_size(DEFAULT_EXTENT_SIZE), codec(DEFAULT_CODEC), codec_level(0),
+    adaptive(false), sampling(false), sampling_period(DEFAULT_SAMPLE_PERIOD),
+    online(false), online_traces(true), report_path("./sword_report"),
+    inprocess(false), inprocess_threads(DEFAULT_INPROCESS_THREADS),
+    inprocess_memory((uint64_t) DEFAULT_INPROCESS_MEMORY << 20) {
     if(env) {
-      char tmp_string[255];
-      int ret = sscanf(env, "traces_path=%s", tmp_string);
-      if(!ret) {
-	std::cerr << "Illegal values for SWORD_OPTIONS variable, no option has been set." << std::endl;
-	
-      } else {
-	traces_path = tmp_string;
-	// if(traces_path.back() != '/')
-	//   traces_path += "/";
+      std::istringstream options(env);
+      std::string option;
+      while(options >> option) {
+        char tmp_string[255];
+        unsigned tmp_unsigned;
+        if(sscanf(option.c_str(), "traces_path=%254s", tmp_string) == 1) {
+          traces_path = tmp_string;
+          // if(traces_path.back() != '/')
+          //   traces_path += "/";
+        } else if(sscanf(option.c_str(), "compression_threads=%u", &tmp_unsigned) == 1 && tmp_unsigned > 0) {
+          compression_threads = tmp_unsigned;
+        } else if(sscanf(option.c_str(), "ring_depth=%u", &tmp_unsigned) == 1 &&
+                  tmp_unsigned > 1 && tmp_unsigned <= MAX_RING_DEPTH) {
+          ring_depth = tmp_unsigned;
+        } else if(option == "block_format=raw") {
+          block_format = block_raw;
+        } else if(option == "block_format=columnar") {
+          block_format = block_columnar;
+        } else if(sscanf(option.c_str(), "access_runs=%u", &tmp_unsigned) == 1 && tmp_unsigned <= 1) {
+          access_runs = tmp_unsigned;
+        } else if(sscanf(option.c_str(), "extent_size=%u", &tmp_unsigned) == 1 && tmp_unsigned > 0) {
+          extent_size = (uint64_t) tmp_unsigned << 20;
+        } else if(sscanf(option.c_str(), "codec=%254s", tmp_string) == 1 && codec_parse(tmp_string, &codec)) {
+        } else if(sscanf(option.c_str(), "codec_level=%u", &tmp_unsigned) == 1) {
+          codec_level = tmp_unsigned;
+        } else if(sscanf(option.c_str(), "adaptive=%u", &tmp_unsigned) == 1 && tmp_unsigned <= 1) {
+          adaptive = tmp_unsigned;
+        } else if(sscanf(option.c_str(), "sampling=%u", &tmp_unsigned) == 1 && tmp_unsigned <= 1) {
+          sampling = tmp_unsigned;
+        } else if(sscanf(option.c_str(), "sampling_period=%u", &tmp_unsigned) == 1 &&
+                  tmp_unsigned > 0 && (tmp_unsigned & (tmp_unsigned - 1)) == 0) {
+          sampling_period = tmp_unsigned;
+        } else if(sscanf(option.c_str(), "online=%u", &tmp_unsigned) == 1 && tmp_unsigned <= 1) {
+          online = tmp_unsigned;
+        } else if(sscanf(option.c_str(), "online_traces=%u", &tmp_unsigned) == 1 && tmp_unsigned <= 1) {
+          online_traces = tmp_unsigned;
+        } else if(sscanf(option.c_str(), "online_cpus=%254s", tmp_string) == 1) {
+          online_cpus = tmp_string;
+        } else if(sscanf(option.c_str(), "report_path=%254s", tmp_string) == 1) {
+          report_path = tmp_string;
+        } else if(sscanf(option.c_str(), "inprocess=%u", &tmp_unsigned) == 1 && tmp_unsigned <= 1) {
+          inprocess = tmp_unsigned;
+        } else if(sscanf(option.c_str(), "inprocess_threads=%u", &tmp_unsigned) == 1 && tmp_unsigned > 0) {
+          inprocess_threads = tmp_unsigned;
+        } else if(sscanf(option.c_str(), "inprocess_memory=%u", &tmp_unsigned) == 1 && tmp_unsigned > 0) {
+          inprocess_memory = (uint64_t) tmp_unsigned << 20;
+        } else if(sscanf(option.c_str(), "inprocess_cpus=%254s", tmp_string) == 1) {
+          std::istringstream cpus(tmp_string);
+          std::string cpu;
+          while(std::getline(cpus, cpu, ','))
+            inprocess_cpus.push_back(std::stoi(cpu));
+        } else if(sscanf(option.c_str(), "compression_cpus=%254s", tmp_string) == 1) {
+          std::istringstream cpus(tmp_string);
+          std::string cpu;
+          while(std::getline(cpus, cpu, ','))
+            compression_cpus.push_back(std::stoi(cpu));
+        } else {
+          std::cerr << "Illegal value for SWORD_OPTIONS variable: \"" << option << "\", option ignored." << std::endl;
+        }
       }
     }
   }
@@ -0,0 +1,336 @@
+//===-- sword_inprocess.h ------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// In-process analysis (inprocess=1), an alternative to writing the traces.
+// A thread keeps its blocks in memory until it closes its barrier interval;
+// once every thread of the team closed it, the interval goes to a pool of
+// analysis threads, which build the interval trees of its threads
+// (tools/sword-tree-analysis.h), record the races and free the blocks. The
+// races and the coverage are written in report_path when the program
+// terminates.
+// The blocks held and queued for analysis are bounded by inprocess_memory.
+// A thread that cannot hold a block any more spills the interval: every
+// thread of the team writes its blocks of the interval to the trace files,
+// for the offline analysis, as usual. Once a thread handed its blocks over
+// the interval cannot spill, the others go beyond the budget instead.
+// Only the barrier intervals of the outermost parallel regions are analyzed
+// in-process, a thread that starts a nested region spills its interval.
+// The analysis needs the INPROCESS CMake option, which links the interval
+// trees into the run-time.
+//===----------------------------------------------------------------------===//
+
+#ifndef SWORD_INPROCESS_H
+#define SWORD_INPROCESS_H
+
+#include "sword_common.h"
+
+#ifdef INPROCESS
+#include "tools/sword-sweep-analysis.h"
+#include "tools/sword-tree-analysis.h"
+#endif
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#define INPROCESS_REPORT		"race_report_inprocess"
+#define DEFAULT_INPROCESS_THREADS	2
+#define DEFAULT_INPROCESS_MEMORY	1024 // MB
+
+static bool inprocess_available() {
+#ifdef INPROCESS
+  return true;
+#else
+  return false;
+#endif
+}
+
+enum IntervalMode {
+  interval_open = 0,
+  interval_memory,  // a thread handed its blocks over
+  interval_spilled  // the blocks are in the trace files
+};
+
+struct InProcessInterval {
+  uint64_t pid;
+  uint64_t bid;
+  unsigned team;
+  std::atomic<int> mode;
+  // Under the lock of the analyzer.
+  unsigned closed;
+  std::map<unsigned, std::vector<TraceItem>> traces; // threads with accesses
+  size_t bytes;
+  uint64_t recorded;
+  uint64_t sampled_out;
+
+  InProcessInterval(uint64_t p, uint64_t b, unsigned t)
+    : pid(p), bid(b), team(t), mode(interval_open), closed(0), bytes(0),
+      recorded(0), sampled_out(0) {}
+
+  bool spilled() const {
+    return mode.load(std::memory_order_acquire) == interval_spilled;
+  }
+
+  // Returns true if the interval spilled, false if it is in memory for good.
+  bool spill() {
+    int m = interval_open;
+    return mode.compare_exchange_strong(m, interval_spilled) || m == interval_spilled;
+  }
+};
+
+class InProcessAnalyzer {
+ private:
+  std::mutex mtx; // intervals, queue and sites
+  std::condition_variable cv;
+  std::map<std::pair<uint64_t, uint64_t>, InProcessInterval *> intervals;
+  std::deque<InProcessInterval *> ready;
+  std::vector<std::thread> workers;
+  bool stopping;
+  std::shared_ptr<const std::vector<uint8_t>> site_size_types;
+
+  uint64_t budget;
+  std::atomic<uint64_t> held;
+  std::string report_path;
+
+  std::mutex rmtx; // races and coverage
+  std::unordered_set<size_t> hash_races;
+  std::vector<RaceInfo> races;
+
+  // Same report as the offline analysis, a pair of pcs is reported once.
+  void report(uint64_t address, uint8_t rw1, uint8_t rw2, uint8_t size1, uint8_t size2, uint64_t pc1, uint64_t pc2) {
+    std::size_t hash1 = 0;
+    boost::hash_combine(hash1, pc1);
+    boost::hash_combine(hash1, pc2);
+    std::size_t hash2 = 0;
+    boost::hash_combine(hash2, pc2);
+    boost::hash_combine(hash2, pc1);
+    std::unique_lock<std::mutex> lock(rmtx);
+    if(hash_races.count(hash1) || hash_races.count(hash2))
+      return;
+    hash_races.insert(hash1);
+    hash_races.insert(hash2);
+    races.push_back(RaceInfo(address, rw1, size1, pc1, rw2, size2, pc2));
+  }
+
+  // Races need two threads with accesses in the interval.
+  void analyze(InProcessInterval *interval, const std::vector<uint8_t> &size_types) {
+#ifdef INPROCESS
+    if(interval->traces.size() > 1) {
+      std::list<TreeRoot> interval_trees;
+      interval_tree_locksets locksets;
+      std::vector<interval_tree_root *> roots;
+      for(std::pair<const unsigned, std::vector<TraceItem>> &t : interval->traces) {
+        interval_tree_root *root = new interval_tree_root(&locksets);
+        roots.push_back(root);
+        interval_trees.push_back(TreeRoot(t.first, root));
+        std::set<size_t> mutex;
+        insert_items(t.second.data(), t.second.data() + t.second.size(), mutex, size_types, root, t.first);
+      }
+      std::mutex tree_mtx;
+      TreeRaces tree_races;
+      if(!locksets.overflowed()) {
+        check_trees(interval_trees, false, tree_mtx, tree_races);
+      } else {
+        // The ids of the nodes ran out, the sweep keeps 32-bit ids.
+        INFO(std::cerr, "SWORD: More than " << MAX_LOCKSETS - 1 << " locksets in a barrier interval, the interval is swept.");
+        interval_tree_locksets sweep_locksets(SWEEP_MAX_LOCKSETS);
+        std::vector<SweepIntervals> threads;
+        for(std::pair<const unsigned, std::vector<TraceItem>> &t : interval->traces) {
+          threads.push_back(SweepIntervals(t.first));
+          std::set<size_t> mutex;
+          sweep_insert_items(t.second.data(), t.second.data() + t.second.size(), mutex, size_types, &sweep_locksets, threads.back());
+        }
+        for(SweepIntervals &intervals : threads)
+          intervals.sort();
+        sweep_intervals(threads, &sweep_locksets, tree_races);
+      }
+      for(std::pair<const unsigned, std::vector<TraceItem>> &t : interval->traces)
+        std::vector<TraceItem>().swap(t.second);
+      for(const std::pair<interval_tree_node, interval_tree_node> &race : tree_races) {
+        const interval_tree_node &i = race.first;
+        const interval_tree_node &j = race.second;
+        report(i.start, (AccessType) (i.size_type & 0x0F), (AccessType) (j.size_type & 0x0F),
+               i.size_type >> 4, j.size_type >> 4, i.pc - 1, j.pc - 1);
+      }
+      // Merged trees are empty, except the two of the last pair.
+      for(interval_tree_root *root : roots) {
+        interval_tree_free(root);
+        delete root;
+      }
+    }
+#endif
+    if(interval->sampled_out > 0) {
+      std::unique_lock<std::mutex> lock(rmtx);
+      std::string filename = report_path + "/" + COVERAGE_FILE + std::to_string(interval->pid);
+      FILE *coverage = fopen(filename.c_str(), "a");
+      if(coverage) {
+        fprintf(coverage, COVERAGE_FORMAT, interval->bid, interval->recorded, interval->sampled_out);
+        fclose(coverage);
+      }
+    }
+    release(interval->bytes);
+    analyzed++;
+    delete interval;
+  }
+
+  void run(int cpu) {
+    if(cpu >= 0) {
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      CPU_SET(cpu, &cpuset);
+      if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0)
+        INFO(std::cerr, "SWORD: Could not pin analysis thread to cpu " << cpu << ".");
+    }
+    std::unique_lock<std::mutex> lock(mtx);
+    while(true) {
+      if(ready.empty()) {
+        if(stopping)
+          break;
+        cv.wait(lock);
+        continue;
+      }
+      InProcessInterval *interval = ready.front();
+      ready.pop_front();
+      std::shared_ptr<const std::vector<uint8_t>> size_types = site_size_types;
+      lock.unlock();
+      analyze(interval, *size_types);
+      lock.lock();
+    }
+  }
+
+ public:
+  std::atomic<uint64_t> analyzed;
+  std::atomic<uint64_t> spilled;
+  // Bytes held beyond the budget by intervals that could not spill.
+  std::atomic<uint64_t> overdraft;
+  std::atomic<uint64_t> peak;
+
+  InProcessAnalyzer(unsigned nworkers, const std::vector<int> &cpus, uint64_t memory, const std::string &path)
+    : stopping(false), site_size_types(new std::vector<uint8_t>()), budget(memory), held(0),
+      report_path(path), analyzed(0), spilled(0), overdraft(0), peak(0) {
+    for(unsigned i = 0; i < nworkers; i++)
+      workers.push_back(std::thread(&InProcessAnalyzer::run, this, cpus.empty() ? -1 : cpus[i % cpus.size()]));
+  }
+
+  // size_type of every access site, indexed by site id, for the intervals
+  // analyzed from now on.
+  void set_sites(const std::vector<uint8_t> &size_types) {
+    std::shared_ptr<const std::vector<uint8_t>> s(new std::vector<uint8_t>(size_types));
+    std::unique_lock<std::mutex> lock(mtx);
+    site_size_types = s;
+  }
+
+  // The interval (pid, bid) of a team, created by the first thread that
+  // starts it.
+  InProcessInterval *join(uint64_t pid, uint64_t bid, unsigned team) {
+    std::unique_lock<std::mutex> lock(mtx);
+    InProcessInterval *&interval = intervals[std::make_pair(pid, bid)];
+    if(!interval)
+      interval = new InProcessInterval(pid, bid, team);
+    return interval;
+  }
+
+  bool reserve(size_t bytes) {
+    uint64_t h = held.load(std::memory_order_relaxed);
+    do {
+      if(h + bytes > budget)
+        return false;
+    } while(!held.compare_exchange_weak(h, h + bytes));
+    h += bytes;
+    for(uint64_t p = peak.load(); h > p && !peak.compare_exchange_weak(p, h);) {}
+    return true;
+  }
+
+  void force(size_t bytes) {
+    uint64_t h = held += bytes;
+    overdraft += bytes;
+    for(uint64_t p = peak.load(); h > p && !peak.compare_exchange_weak(p, h);) {}
+  }
+
+  void release(size_t bytes) {
+    held -= bytes;
+  }
+
+  // A thread closes its interval with the items it holds, reserved before.
+  // Returns false if the interval spilled: the items stay with the thread,
+  // which writes them to the trace files.
+  bool close(InProcessInterval *interval, unsigned tid, std::vector<TraceItem> &items,
+             uint64_t recorded, uint64_t sampled_out) {
+    int m = interval_open;
+    bool memory = interval->mode.compare_exchange_strong(m, interval_memory) || m == interval_memory;
+    std::unique_lock<std::mutex> lock(mtx);
+    if(memory) {
+      if(!items.empty()) {
+        interval->bytes += items.size() * sizeof(TraceItem);
+        interval->traces[tid].swap(items);
+      }
+      interval->recorded += recorded;
+      interval->sampled_out += sampled_out;
+    }
+    if(++interval->closed >= interval->team) {
+      intervals.erase(std::make_pair(interval->pid, interval->bid));
+      if(interval->spilled()) {
+        spilled++;
+        delete interval;
+      } else {
+        ready.push_back(interval);
+        cv.notify_one();
+      }
+    }
+    return memory;
+  }
+
+  // Analyzes what is left, also the intervals that some threads of their
+  // team never closed, and writes the races. Returns their number.
+  size_t finalize() {
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      stopping = true;
+    }
+    cv.notify_all();
+    for(std::thread &worker : workers)
+      worker.join();
+    workers.clear();
+    for(std::pair<const std::pair<uint64_t, uint64_t>, InProcessInterval *> &interval : intervals) {
+      if(interval.second->spilled()) {
+        spilled++;
+        delete interval.second;
+      } else {
+        analyze(interval.second, *site_size_types);
+      }
+    }
+    intervals.clear();
+
+    if(!races.empty()) {
+      std::ofstream file(report_path + "/" + INPROCESS_REPORT, std::ios::out | std::ios::binary);
+      size_t size = races.size();
+      file.write((char*) &size, sizeof(size));
+      file.write(reinterpret_cast<char*>(races.data()), races.size() * sizeof(RaceInfo));
+      file.close();
+    }
+    return races.size();
+  }
+};
+
+#endif  // SWORD_INPROCESS_H
@@ -21,6 +21,32 @@ void __sword_func_entry(void *pc) {}
 
 void __sword_func_exit() {}
 
+// Slow path of the inline trace append emitted by InstrumentParallel
+// (-sword-inline-fastpath): called once __sword_idx__ reached the end of the
+// buffer.
+void __sword_flush_buffer() {
+	FLUSH_BUFFER
+}
+
+// Called by the module constructor emitted by InstrumentParallel
+// (-sword-site-ids), *base receives the ID of the first site of the table.
+void __sword_register_sites(const SwordSite *sites, uint32_t count, uint32_t *base) {
+	std::unique_lock<std::mutex> lock(smtx);
+	uint32_t next = 0;
+	if(!site_tables().empty())
+		next = site_tables().back().base + site_tables().back().count;
+	site_tables().push_back({ sites, count, next });
+	*base = next;
+	if(sword_inprocess)
+		sword_inprocess->set_sites(site_size_types());
+}
+
+// Load or store of an instrumented site, its size and type are the ones of
+// the site.
+void __sword_site_access(void *addr, uint32_t site) {
+	SAVE_SITE_ACCESS
+}
+
 // UTIL
 
 // READS
@@ -68,6 +94,74 @@ void __sword_write16(void *addr) {
 }
 // WRITES
 
+// RANGES
+
+// Loop-level ranges emitted by InstrumentParallel (-sword-loop-ranges):
+// count accesses, stride bytes apart, starting at addr.
+void __sword_read_range1(void *addr, int64_t stride, uint64_t count) {
+	SAVE_RANGE(size1, unsafe_read)
+}
+
+void __sword_read_range2(void *addr, int64_t stride, uint64_t count) {
+	SAVE_RANGE(size2, unsafe_read)
+}
+
+void __sword_read_range4(void *addr, int64_t stride, uint64_t count) {
+	SAVE_RANGE(size4, unsafe_read)
+}
+
+void __sword_read_range8(void *addr, int64_t stride, uint64_t count) {
+	SAVE_RANGE(size8, unsafe_read)
+}
+
+void __sword_read_range16(void *addr, int64_t stride, uint64_t count) {
+	SAVE_RANGE(size16, unsafe_read)
+}
+
+void __sword_write_range1(void *addr, int64_t stride, uint64_t count) {
+	SAVE_RANGE(size1, unsafe_write)
+}
+
+void __sword_write_range2(void *addr, int64_t stride, uint64_t count) {
+	SAVE_RANGE(size2, unsafe_write)
+}
+
+void __sword_write_range4(void *addr, int64_t stride, uint64_t count) {
+	SAVE_RANGE(size4, unsafe_write)
+}
+
+void __sword_write_range8(void *addr, int64_t stride, uint64_t count) {
+	SAVE_RANGE(size8, unsafe_write)
+}
+
+void __sword_write_range16(void *addr, int64_t stride, uint64_t count) {
+	SAVE_RANGE(size16, unsafe_write)
+}
+
+void __sword_site_range(void *addr, int64_t stride, uint64_t count, uint32_t site) {
+	SAVE_SITE_RANGE
+}
+
+// memset/memcpy/memmove replaced by InstrumentParallel: each range is
+// recorded once, then the operation is performed.
+void *__sword_memset(void *addr, int c, uintptr_t size) {
+	write_memory_range((size_t) addr, size, unsafe_write, CALLERPC);
+	return memset(addr, c, size);
+}
+
+void *__sword_memcpy(void *dst, const void *src, uintptr_t size) {
+	write_memory_range((size_t) src, size, unsafe_read, CALLERPC);
+	write_memory_range((size_t) dst, size, unsafe_write, CALLERPC);
+	return memcpy(dst, src, size);
+}
+
+void *__sword_memmove(void *dst, const void *src, uintptr_t size) {
+	write_memory_range((size_t) src, size, unsafe_read, CALLERPC);
+	write_memory_range((size_t) dst, size, unsafe_write, CALLERPC);
+	return memmove(dst, src, size);
+}
+// RANGES
+
 // ATOMICS
 
 // LOAD
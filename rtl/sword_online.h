@@ -0,0 +1,186 @@
+//===-- sword_online.h ---------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Online analysis (online=1). The run-time creates a shared memory segment
+// with a ring per thread and starts sword-analysisd on it. At every barrier
+// a thread publishes the index entries of the blocks it wrote since the
+// previous barrier, then the interval that ends. As soon as all the threads
+// of the team of a barrier interval published it, the daemon reads their
+// blocks from the trace container (the writers' mappings are in the page
+// cache), builds the interval trees, reports the races and drops the
+// interval; with online_traces=0 it also punches the blocks of the interval
+// out of the container, so the traces do not pile up on disk.
+// The rings are single producer (the thread), single consumer (the daemon);
+// a thread waits while its ring is full, unless the daemon is gone.
+//===----------------------------------------------------------------------===//
+
+#ifndef SWORD_ONLINE_H
+#define SWORD_ONLINE_H
+
+#include "sword_container.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#define ONLINE_MAGIC			"SWORDSHM"
+#define ONLINE_VERSION			1
+#define ONLINE_MAX_THREADS		256
+#define ONLINE_RING_SIZE		1024 // messages, a power of 2
+#define ONLINE_DAEMON			"sword-analysisd"
+#define ONLINE_REPORT			"race_report_online"
+
+enum OnlineMessageKind {
+  online_block = 1,
+  online_interval
+};
+
+struct OnlineMessage {
+  uint32_t kind; // OnlineMessageKind
+  uint32_t team; // threads of the team, for online_interval
+  union {
+    BlockIndexEntry block;
+    IntervalRecord interval;
+  };
+};
+
+struct OnlineRing {
+  std::atomic<uint64_t> head; // next message of the daemon
+  char pad0[64 - sizeof(std::atomic<uint64_t>)];
+  std::atomic<uint64_t> tail; // next message of the thread
+  char pad1[64 - sizeof(std::atomic<uint64_t>)];
+  OnlineMessage messages[ONLINE_RING_SIZE];
+};
+
+// Zero-filled by ftruncate, rings start empty.
+struct OnlineSegment {
+  char magic[8];
+  uint32_t version;
+  uint32_t keep_traces;
+  std::atomic<uint32_t> done;    // the program terminated
+  std::atomic<uint32_t> threads; // rings in use
+  char traces_path[PATH_MAX];
+  char executable[PATH_MAX];
+  OnlineRing rings[ONLINE_MAX_THREADS];
+};
+
+static std::string online_segment_name(pid_t pid) {
+  return "/sword-" + std::to_string(pid);
+}
+
+// Run-time side.
+class OnlinePublisher {
+ private:
+  OnlineSegment *segment;
+  std::string name;
+  pid_t daemon;
+  std::atomic<bool> alive;
+
+ public:
+  OnlinePublisher() : segment(NULL), daemon(0), alive(false) {}
+
+  // Creates the segment and starts the daemon with args, the daemon finds
+  // the segment in its --segment option.
+  bool open(const std::string &traces_path, bool keep_traces, std::vector<std::string> args) {
+    name = online_segment_name(getpid());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if(fd < 0)
+      return false;
+    if(ftruncate(fd, sizeof(OnlineSegment)) != 0) {
+      ::close(fd);
+      return false;
+    }
+    void *m = mmap(NULL, sizeof(OnlineSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(m == MAP_FAILED)
+      return false;
+    segment = (OnlineSegment *) m;
+    memcpy(segment->magic, ONLINE_MAGIC, sizeof(segment->magic));
+    segment->version = ONLINE_VERSION;
+    segment->keep_traces = keep_traces;
+    strncpy(segment->traces_path, traces_path.c_str(), PATH_MAX - 1);
+    if(readlink("/proc/self/exe", segment->executable, PATH_MAX - 1) < 0)
+      segment->executable[0] = '\0';
+
+    args.insert(args.begin(), { ONLINE_DAEMON, "--segment", name });
+    std::vector<char *> argv;
+    for(std::string &arg : args)
+      argv.push_back(&arg[0]);
+    argv.push_back(NULL);
+    if((errno = posix_spawnp(&daemon, ONLINE_DAEMON, NULL, NULL, argv.data(), environ)) != 0) {
+      shm_unlink(name.c_str());
+      return false;
+    }
+    alive = true;
+    return true;
+  }
+
+  void publish(unsigned tid, const OnlineMessage &m) {
+    if(tid >= ONLINE_MAX_THREADS || !alive.load(std::memory_order_relaxed))
+      return;
+    uint32_t threads = segment->threads.load(std::memory_order_relaxed);
+    while(threads <= tid && !segment->threads.compare_exchange_weak(threads, tid + 1)) {}
+    OnlineRing *r = &segment->rings[tid];
+    uint64_t tail = r->tail.load(std::memory_order_relaxed);
+    while(tail - r->head.load(std::memory_order_acquire) >= ONLINE_RING_SIZE) {
+      if(waitpid(daemon, NULL, WNOHANG) != 0) {
+        alive = false;
+        return;
+      }
+      sched_yield();
+    }
+    r->messages[tail % ONLINE_RING_SIZE] = m;
+    r->tail.store(tail + 1, std::memory_order_release);
+  }
+
+  void block(unsigned tid, const BlockIndexEntry &e) {
+    OnlineMessage m;
+    m.kind = online_block;
+    m.team = 0;
+    m.block = e;
+    publish(tid, m);
+  }
+
+  void interval(unsigned tid, const IntervalRecord &r, unsigned team) {
+    OnlineMessage m;
+    m.kind = online_interval;
+    m.team = team;
+    m.interval = r;
+    publish(tid, m);
+  }
+
+  // Waits for the daemon to analyze what is left. Returns its exit status,
+  // -1 if it is gone.
+  int close() {
+    int status = -1;
+    segment->done.store(1, std::memory_order_release);
+    if(!alive || waitpid(daemon, &status, 0) != daemon || !WIFEXITED(status))
+      status = -1;
+    else
+      status = WEXITSTATUS(status);
+    alive = false;
+    munmap(segment, sizeof(OnlineSegment));
+    shm_unlink(name.c_str());
+    return status;
+  }
+};
+
+#endif  // SWORD_ONLINE_H
@@ -0,0 +1,274 @@
+//===-- sword_pool.h -----------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Fixed pool of compression/writer threads. Every OMPT thread owns a
+// single-producer single-consumer queue of full blocks that is served by
+// one worker (thread id modulo the number of workers), so the blocks of a
+// thread are written in order and the hand-off never takes a lock. The
+// barrier intervals go through the same queue, so a thread does not wait
+// for its blocks at a barrier.
+//===----------------------------------------------------------------------===//
+
+#ifndef SWORD_POOL_H
+#define SWORD_POOL_H
+
+#include "sword_buffer.h"
+#include "sword_common.h"
+#include "sword_container.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <vector>
+
+// A thread has at most ring_depth blocks in flight (MAX_RING_DEPTH).
+#define QUEUE_DEPTH				16
+#define CACHE_LINE				64
+// Empty polls of all its queues before a worker goes to sleep.
+#define WORKER_SPINS			1024
+#define WORKER_SLEEP_US			1000
+
+bool dump_to_file(std::vector<TraceItem> *accesses, size_t size, size_t nmemb,
+                  TraceStream *stream, size_t *file_offset_end, unsigned queued);
+
+struct CompressionJob {
+  // NULL for a barrier interval, recorded once the blocks queued before it
+  // have been written.
+  TraceBuffer *trace_buffer;
+  size_t size;
+  size_t nmemb;
+  TraceStream *stream;
+  size_t *file_offset_end;
+  size_t *file_offset_begin;
+  IntervalRecord interval;
+};
+
+class CompressionWorker;
+
+class JobQueue {
+ private:
+  CompressionJob jobs[QUEUE_DEPTH];
+  // head is advanced by the worker once a job has been written, tail by
+  // the OMPT thread once a job has been queued.
+  char pad0[CACHE_LINE];
+  std::atomic<uint64_t> head;
+  char pad1[CACHE_LINE - sizeof(std::atomic<uint64_t>)];
+  std::atomic<uint64_t> tail;
+  char pad2[CACHE_LINE - sizeof(std::atomic<uint64_t>)];
+
+ public:
+  CompressionWorker *worker;
+
+  JobQueue() : head(0), tail(0), worker(NULL) {}
+
+  // Producer side.
+  bool push(const CompressionJob &job) {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    if(t - head.load(std::memory_order_acquire) == QUEUE_DEPTH)
+      return false;
+    jobs[t % QUEUE_DEPTH] = job;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Jobs queued and not written yet.
+  unsigned size() const {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+  }
+
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+  // Consumer side: the job stays in the queue until pop(), so empty()
+  // means that everything pushed has also been written.
+  CompressionJob *front() {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if(h == tail.load(std::memory_order_acquire))
+      return NULL;
+    return &jobs[h % QUEUE_DEPTH];
+  }
+
+  void pop() {
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+};
+
+class CompressionWorker {
+ public:
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::atomic<bool> sleeping;
+  std::vector<JobQueue *> queues;
+  std::thread thread;
+  int cpu;
+
+  CompressionWorker() : sleeping(false), cpu(-1) {}
+};
+
+class CompressionPool {
+ private:
+  std::vector<CompressionWorker *> workers;
+  std::atomic<bool> stopping;
+
+  // Returns true if at least one job has been written. The lock guards
+  // the list of queues only and is dropped while a block is compressed; a
+  // queue is not detached before its last job has been popped, which
+  // happens under the lock.
+  // The interval ends with the last block written, and the next one
+  // begins there.
+  static void record_interval(CompressionJob *job) {
+    const IntervalRecord &r = job->interval;
+    job->stream->interval(r.pid, r.ppid, r.bid, r.offset, r.span, r.level,
+                          *job->file_offset_begin, *job->file_offset_end, r.recorded, r.sampled_out);
+    *job->file_offset_begin = *job->file_offset_end;
+  }
+
+  static bool serve(CompressionWorker *w) {
+    bool busy = false;
+    std::unique_lock<std::mutex> lock(w->mtx);
+    for(size_t i = 0; i < w->queues.size(); i++) {
+      JobQueue *q = w->queues[i];
+      CompressionJob *job;
+      while((job = q->front()) != NULL) {
+        lock.unlock();
+        if(job->trace_buffer) {
+          dump_to_file(&job->trace_buffer->accesses, job->size, job->nmemb, job->stream,
+                       job->file_offset_end, q->size() - 1);
+          job->trace_buffer->release();
+        } else {
+          record_interval(job);
+        }
+        lock.lock();
+        q->pop();
+        busy = true;
+      }
+    }
+    return busy;
+  }
+
+  void run(CompressionWorker *w) {
+    if(w->cpu >= 0) {
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      CPU_SET(w->cpu, &cpuset);
+      if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0)
+        INFO(std::cerr, "SWORD: Could not pin compression thread to cpu " << w->cpu << ".");
+    }
+
+    unsigned idle = 0;
+    while(true) {
+      if(serve(w)) {
+        idle = 0;
+        continue;
+      }
+      if(stopping.load(std::memory_order_acquire)) {
+        // Queues may have been filled after the last pass.
+        if(!serve(w))
+          break;
+        continue;
+      }
+      if(++idle < WORKER_SPINS) {
+        sched_yield();
+        continue;
+      }
+      // A producer wakes the worker up if it sees the flag, the timeout
+      // covers a push that raced with going to sleep.
+      std::unique_lock<std::mutex> lock(w->mtx);
+      w->sleeping.store(true);
+      w->cv.wait_for(lock, std::chrono::microseconds(WORKER_SLEEP_US));
+      w->sleeping.store(false);
+      idle = 0;
+    }
+  }
+
+ public:
+  // Number of times a producer found its queue full.
+  std::atomic<uint64_t> saturated;
+
+  CompressionPool(unsigned nworkers, const std::vector<int> &cpus)
+    : stopping(false), saturated(0) {
+    for(unsigned i = 0; i < nworkers; i++) {
+      CompressionWorker *w = new CompressionWorker();
+      if(!cpus.empty())
+        w->cpu = cpus[i % cpus.size()];
+      workers.push_back(w);
+    }
+    for(CompressionWorker *w : workers)
+      w->thread = std::thread(&CompressionPool::run, this, w);
+  }
+
+  void attach(JobQueue *q, int tid) {
+    CompressionWorker *w = workers[tid % workers.size()];
+    std::unique_lock<std::mutex> lock(w->mtx);
+    q->worker = w;
+    w->queues.push_back(q);
+  }
+
+  // The queue must be empty.
+  void detach(JobQueue *q) {
+    CompressionWorker *w = q->worker;
+    if(!w)
+      return;
+    std::unique_lock<std::mutex> lock(w->mtx);
+    for(auto it = w->queues.begin(); it != w->queues.end(); ++it) {
+      if(*it == q) {
+        w->queues.erase(it);
+        break;
+      }
+    }
+    q->worker = NULL;
+  }
+
+  void submit(JobQueue *q, const CompressionJob &job) {
+    if(!q->push(job)) {
+      saturated++;
+      do {
+        if(q->worker->sleeping.load(std::memory_order_relaxed))
+          q->worker->cv.notify_one();
+        sched_yield();
+      } while(!q->push(job));
+    }
+    if(q->worker->sleeping.load(std::memory_order_relaxed))
+      q->worker->cv.notify_one();
+  }
+
+  // Blocks until every job queued on q has been written.
+  void wait(JobQueue *q) {
+    while(!q->empty()) {
+      if(q->worker->sleeping.load(std::memory_order_relaxed))
+        q->worker->cv.notify_one();
+      sched_yield();
+    }
+  }
+
+  // Drains all the queues and joins the workers.
+  void stop() {
+    stopping.store(true, std::memory_order_release);
+    for(CompressionWorker *w : workers) {
+      w->cv.notify_one();
+      w->thread.join();
+      for(JobQueue *q : w->queues)
+        q->worker = NULL;
+      delete w;
+    }
+    workers.clear();
+  }
+
+  unsigned size() const {
+    return workers.size();
+  }
+};
+
+#endif  // SWORD_POOL_H
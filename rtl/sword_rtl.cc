@@ -11,17 +11,9 @@
 //===----------------------------------------------------------------------===//
 
 #include "sword_rtl.h"
+#include "sword_block.h"
 #include "sword_flags.h"
 
-#ifdef SNAPPY
-#include "snappy/snappy.h"
-#endif
-
-#ifdef LZ4
-#include "lz4/lz4.h"
-#define ACCELERATION 5
-#endif
-
 #include <boost/filesystem.hpp>
 
 #include <assert.h>
@@ -30,6 +22,7 @@
 
 #include <cmath>
 #include <fstream>
+#include <memory>
 #include <sstream>
 
 #define SET_SIZE 87382
@@ -64,86 +57,342 @@ static uint64_t my_next_id()
 }
 
 SwordFlags *sword_flags;
+CompressionPool *sword_pool;
+TraceContainer *sword_container;
+// NULL unless online=1.
+OnlinePublisher *sword_online;
+// NULL unless inprocess=1.
+InProcessAnalyzer *sword_inprocess;
+AdaptiveController sword_adapt;
+BufferPool *sword_buffers;
+std::atomic<uint64_t> sword_ring_dry(0);
+std::atomic<uint64_t> sword_blocks(0);
+std::atomic<uint64_t> sword_recorded(0);
+std::atomic<uint64_t> sword_sampled_out(0);
+// sword_flags->access_runs, sampling and sampling_period, read on every
+// access.
+bool sword_access_runs;
+bool sword_sampling;
+uint32_t sword_sampling_period;
+
+bool dump_to_file(std::vector<TraceItem> *accesses, size_t size, size_t nmemb,
+                  TraceStream *stream, size_t *file_offset_end, unsigned queued) {
+  // Runs on the compression threads.
+  uint64_t wall = clock_ns(CLOCK_MONOTONIC);
+  uint64_t cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+  // Freed when the compression thread exits.
+  thread_local std::unique_ptr<BlockEncoder> encoder(new BlockEncoder());
+  thread_local std::unique_ptr<unsigned char[]> encoded(new unsigned char[ENCODED_LEN]);
+  CodecSetting setting = sword_adapt.setting();
+  // tcgen models the items itself, it takes raw blocks.
+  BlockFormat format = (setting.codec == codec_tcgen) ? block_raw : sword_flags->block_format;
+  size_t encoded_len = encoder->encode(accesses->data(), nmemb, encoded.get(), format);
+
+  // The codec compresses straight in the mapped extent of the stream, the
+  // container writes the header of the block in front of the data.
+  BlockCodec codec = setting.codec;
+  size_t capacity = codec_bound(codec, encoded_len);
+  unsigned char *buffer = sword_container->reserve(stream, capacity);
+  if(!buffer) {
+    INFO(std::cerr, "SWORD: Error allocating an extent of " << sword_container->filename << " - " << strerror(errno) << ".");
+    return false;
+  }
+  size_t out_len = codec_compress(codec, setting.level, encoded.get(), encoded_len, buffer, capacity);
+  if(out_len == 0) {
+    // Write plain
+    codec = codec_none;
+    out_len = codec_compress(codec, 0, encoded.get(), encoded_len, buffer, capacity);
+  }
 
-bool dummy() {
+  sword_container->commit(stream, codec, out_len, encoded_len, nmemb, file_offset_end);
+  sword_adapt.observe(queued, clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu,
+                      clock_ns(CLOCK_MONOTONIC) - wall, encoded_len, out_len);
   return true;
 }
 
-bool dump_to_file(std::vector<TraceItem> *accesses, size_t size, size_t nmemb,
-                  FILE *file, unsigned char *buffer, size_t *file_offset_end) {
-
-#ifdef LZO
-  // LZO
-  lzo_uint *out_len = (lzo_uint *) buffer;
-  lzo1x_1_compress((unsigned char *) accesses->data(), size * nmemb, buffer + sizeof(lzo_uint), out_len, wrkmem);
-
-  size_t tsize = *out_len + sizeof(lzo_uint);
-  fwrite((char *) buffer, tsize, 1, file);
-  *file_offset_end += tsize;
-  // LZO
-#elif defined(SNAPPY)
-  size_t *out_len = (size_t *) buffer;
-  snappy::RawCompress((char *) accesses, size * nmemb, (char*) buffer + sizeof(size_t), out_len);
-  fwrite((char *) buffer, *out_len + sizeof(size_t), 1, file);
-#elif defined(LZ4)
-  const int64_t max_dst_size = LZ4_compressBound(size * nmemb);
-  int64_t *out_len = (int64_t *) buffer;
-  *out_len = LZ4_compress_fast((char *) accesses, (char*) buffer + sizeof(int64_t), size * nmemb, max_dst_size, ACCELERATION);
-
-  // if (out_len < 0) {
-  //   printf("A negative result from LZ4_compress_default indicates a failure trying to compress the data.");
-  // } else if (out_len == 0) {
-  //   printf("A result of 0 means compression worked, but was stopped because the destination buffer couldn't hold all the information.");
-  // }
-
-  fwrite((char *) buffer, *out_len + sizeof(int64_t), 1, file);
-#elif defined(HUFFMAN)
-#elif defined(ARITHMETIC)
-#else
-  size_t ret = fwrite((char *) accesses, size * nmemb, 1, file); // Write plain
-#endif
+#define SWAP_BUFFER                                                     \
+  __sword_accesses__ = &__sword_ring__->next()->accesses;               \
+  __sword_buffer__ = (char *) __sword_accesses__->data();              \
+  __sword_block_items__ = sword_adapt.items();
+
+#define SUBMIT_BUFFER(nmemb)                                            \
+  sword_pool->submit(__sword_queue__,                                   \
+                     { __sword_ring__->hand_off(), sizeof(TraceItem), nmemb, \
+                       __sword_stream__, &__sword_file_offset_end__ }); \
+  SWAP_BUFFER
+
+// Writes the items held for the in-process analysis to the trace files,
+// followed by the current block, once the interval spilled.
+static void spill_held() {
+  std::vector<TraceItem> &held = __sword_held__;
+  if(held.empty())
+    return;
+  sword_inprocess->release(held.size() * sizeof(TraceItem));
+  held.insert(held.end(), __sword_accesses__->begin(), __sword_accesses__->begin() + __sword_idx__);
+  for(size_t i = 0; i < held.size();) {
+    size_t n = std::min<size_t>(__sword_block_items__, held.size() - i);
+    // An access_run item stays in the block of its access.
+    if(i + n < held.size() && held[i + n].getType() == access_run && n > 1)
+      n--;
+    std::copy(held.begin() + i, held.begin() + i + n, __sword_accesses__->begin());
+    SUBMIT_BUFFER(n)
+    i += n;
+  }
+  held.clear();
+  __sword_idx__ = 0;
+  set.clear();
+}
 
+// Keeps the current block in memory for the in-process analysis, or spills
+// the interval if the memory budget is exhausted. Returns false if the
+// block has to be written.
+static bool hold_buffer() {
+  InProcessInterval *interval = __sword_interval__;
+  if(!interval || __sword_status__ != 1)
+    return false;
+  size_t bytes = __sword_idx__ * sizeof(TraceItem);
+  bool keep = false;
+  if(!interval->spilled()) {
+    if(sword_inprocess->reserve(bytes)) {
+      keep = true;
+    } else if(!interval->spill()) {
+      // Another thread of the team handed its blocks over already.
+      sword_inprocess->force(bytes);
+      keep = true;
+    }
+  }
+  if(keep) {
+    __sword_held__.insert(__sword_held__.end(), __sword_accesses__->begin(), __sword_accesses__->begin() + __sword_idx__);
+    return true;
+  }
+  if(__sword_held__.empty())
+    return false;
+  spill_held();
   return true;
 }
 
-#define SWAP_BUFFER                                     \
-  if(__sword_accesses__ == __sword_accesses1__) {       \
-    __sword_accesses__ == __sword_accesses2__;          \
-  } else {                                              \
-    __sword_accesses__ == __sword_accesses1__;          \
-  }
+#define FLUSH_BUFFER                                                    \
+  if(!sword_inprocess || !hold_buffer()) {                              \
+    SUBMIT_BUFFER(__sword_idx__)                                        \
+  }                                                                     \
+  __sword_idx__ = 0;                                                    \
+  set.clear();
 
 #define DUMP_TO_FILE                                                    \
   __sword_idx__++;                                                      \
-  if(__sword_idx__ == NUM_OF_ACCESSES)	{                               \
-    fut.wait();                                                         \
-    fut = std::async(dump_to_file, __sword_accesses__,                  \
-                     sizeof(TraceItem), NUM_OF_ACCESSES, __sword_datafile__, \
-                     out, &__sword_file_offset_end__); \
-    __sword_idx__ = 0;                                                  \
-    set.clear();                                                        \
-    SWAP_BUFFER                                                         \
+  if(__sword_idx__ >= __sword_block_items__)	{                       \
+    FLUSH_BUFFER                                                        \
       }
 
 #define DUMPNOCHECK_TO_FILE                                             \
   if(__sword_idx__ > 0) {                                               \
-    fut.wait();                                                         \
-    fut = std::async(dump_to_file, __sword_accesses__,                  \
-                     sizeof(TraceItem), __sword_idx__, __sword_datafile__, \
-                     out, &__sword_file_offset_end__); \
-    __sword_idx__ = 0;                                                            \
-    set.clear();                                                        \
-    SWAP_BUFFER                                                         \
+    FLUSH_BUFFER                                                        \
       }
 
+#define WRITE_ITEM(item)                                                \
+  (*__sword_accesses__)[__sword_idx__] = item;                          \
+  DUMP_TO_FILE
+
+// Writes a run, the access_run item must be in the same block as its first
+// access.
+static inline void write_run(const TraceItem &first, int64_t stride, uint32_t count) {
+  if(count > 1 && __sword_idx__ + 2 > __sword_block_items__) {
+    DUMPNOCHECK_TO_FILE
+  }
+  WRITE_ITEM(first)
+  if(count > 1) {
+    WRITE_ITEM(TraceItem(access_run, AccessRun(stride, count)))
+  }
+}
+
+// Writes count accesses stride bytes apart, the first one being item, split
+// into runs the analysis can represent.
+static void write_range(TraceItem item, size_t address, int64_t stride, uint64_t count) {
+  uint64_t max_count = RUN_MAX_COUNT;
+  if(stride == 0)
+    count = (count > 0) ? 1 : 0;
+  else if(stride <= -RUN_MAX_STRIDE || stride >= RUN_MAX_STRIDE)
+    max_count = 1;
+  while(count > 0) {
+    uint64_t n = (count < max_count) ? count : max_count;
+    item.setAddress(address);
+    write_run(item, stride, n);
+    address += stride * n;
+    count -= n;
+  }
+}
+
+// Closes the open runs, before the lockset changes or the barrier interval
+// ends.
+static void flush_runs() {
+  if(!sword_access_runs)
+    return;
+  for(RunSlot &slot : __sword_runs__.slots) {
+    if(slot.count) {
+      write_run(slot.getFirst(), slot.stride, slot.count);
+      slot.count = 0;
+    }
+  }
+}
+
+#define RECORD_ACCESS(item, key, address)                               \
+  if(sword_access_runs) {                                               \
+    RunSlot *slot = __sword_runs__.add(key, address);                   \
+    if(slot) {                                                          \
+      if(slot->count)                                                   \
+        write_run(slot->getFirst(), slot->stride, slot->count);         \
+      slot->reset(item, key, address);                                  \
+    }                                                                   \
+  } else {                                                              \
+    WRITE_ITEM(item)                                                    \
+  }
+
+// Closes the barrier interval of the in-process analysis, at a barrier of
+// an outermost region, and starts the next one if next is set. Returns
+// true if the analysis took the interval, false if its blocks are in the
+// trace files and it has to be recorded.
+static bool close_interval(bool next) {
+  InProcessInterval *interval = __sword_interval__;
+  if(!interval)
+    return false;
+  __sword_interval__ = next ? sword_inprocess->join(interval->pid, interval->bid + 1, interval->team) : NULL;
+  if(sword_inprocess->close(interval, __sword_tid__, __sword_held__,
+                            __sword_sampler__.recorded, __sword_sampler__.sampled_out)) {
+    __sword_held__.clear();
+    return true;
+  }
+  spill_held();
+  return false;
+}
+
+// Queues the barrier interval that just ended behind the blocks of the
+// thread. The worker records it with the file offsets of the blocks.
+static void record_interval(uint64_t pid, uint64_t ppid, unsigned offset, unsigned span, int level) {
+  CompressionJob job = { NULL, 0, 0, __sword_stream__, &__sword_file_offset_end__, &__sword_file_offset_begin__ };
+  job.interval.pid = pid;
+  job.interval.ppid = ppid;
+  job.interval.bid = __sword_bid__;
+  job.interval.offset = offset;
+  job.interval.span = span;
+  job.interval.level = level;
+  job.interval.recorded = __sword_sampler__.recorded;
+  job.interval.sampled_out = __sword_sampler__.sampled_out;
+  sword_pool->submit(__sword_queue__, job);
+}
+
+// Hands the blocks written since the previous barrier and the interval that
+// just ended to sword-analysisd. sword-analysisd reads the blocks right
+// away, so the thread waits for its queue, then its worker does not touch
+// the index.
+static void publish_interval(unsigned team) {
+  if(!sword_online)
+    return;
+  sword_pool->wait(__sword_queue__);
+  const std::vector<BlockIndexEntry> &index = __sword_stream__->index;
+  for(; __sword_published__ < index.size(); __sword_published__++)
+    sword_online->block(__sword_tid__, index[__sword_published__]);
+  sword_online->interval(__sword_tid__, __sword_stream__->intervals.back(), team);
+}
+
+// Resets the sampling rates at a barrier, once the interval has been
+// recorded with the counters of the sampler.
+static void next_sampling_interval() {
+  if(!sword_sampling)
+    return;
+  sword_recorded += __sword_sampler__.recorded;
+  sword_sampled_out += __sword_sampler__.sampled_out;
+  __sword_sampler__.next_interval();
+}
+
+#define SAMPLE(key)                                                     \
+  (!sword_sampling || __sword_sampler__.sample(key, sword_sampling_period))
+
 #define SAVE_ACCESS(asize, atype)                                       \
   TraceItem item = TraceItem(data_access, Access(asize,                 \
                                                  atype, (size_t) addr, CALLERPC)); \
-  if(set.check_insert(hash_value(item))) {                              \
-    (*__sword_accesses__)[__sword_idx__] = item;                        \
-    DUMP_TO_FILE                                                        \
+  uint64_t key = RunDetector::key(item.data.access);                    \
+  if(SAMPLE(key) && DEDUP_CHECK_INSERT(item)) {                         \
+    RECORD_ACCESS(item, key, (size_t) addr)                             \
       }
 
+#define SAVE_SITE_ACCESS                                                \
+  TraceItem item = TraceItem(site_access, SiteAccess(site, (size_t) addr)); \
+  uint64_t key = RunDetector::key(item.data.site_access);               \
+  if(SAMPLE(key) && DEDUP_CHECK_INSERT_SITE(item)) {                    \
+    RECORD_ACCESS(item, key, (size_t) addr)                             \
+      }
+
+// Writes the size bytes at address as a run of 16 byte accesses followed by
+// the accesses of the tail. Unlike SAVE_ACCESS, a range is neither sampled
+// nor checked against the DEDUP filter: the filter holds single accesses,
+// and a range dropped on a hit of its first address would lose the others.
+static void write_memory_range(size_t address, size_t size, AccessType type, size_t pc) {
+  size_t n = size >> 4;
+  if(n > 0)
+    write_range(TraceItem(data_access, Access(size16, type, address, pc)), address, 16, n);
+  address += n << 4;
+  for(int s = size8; s >= size1; s--) {
+    if(size & (1 << s)) {
+      WRITE_ITEM(TraceItem(data_access, Access((AccessSize) s, type, address, pc)))
+      address += 1 << s;
+    }
+  }
+}
+
+#define SAVE_RANGE(asize, atype)                                        \
+  write_range(TraceItem(data_access, Access(asize, atype, (size_t) addr, CALLERPC)), \
+              (size_t) addr, stride, count);
+
+#define SAVE_SITE_RANGE                                                 \
+  write_range(TraceItem(site_access, SiteAccess(site, (size_t) addr)),  \
+              (size_t) addr, stride, count);
+
+// Site tables registered by the module constructors of the instrumented
+// modules, a table owns the IDs [base, base + count).
+struct SiteTable {
+  const SwordSite *sites;
+  uint32_t count;
+  uint32_t base;
+};
+
+// Module constructors may run before the static initializers of the
+// run-time when it is linked statically.
+static std::vector<SiteTable> &site_tables() {
+  static std::vector<SiteTable> tables;
+  return tables;
+}
+
+static void dump_sites() {
+  if(site_tables().empty())
+    return;
+
+  std::string filename = sword_flags->traces_path + "/" + SITEFILE;
+  FILE *sitefile = fopen(filename.c_str(), "w");
+  if (!sitefile) {
+    INFO(std::cerr, "SWORD: Error opening sitefile: " << filename << " - " << strerror(errno) << ".");
+    return;
+  }
+  for(const SiteTable &table : site_tables()) {
+    for(uint32_t i = 0; i < table.count; i++) {
+      const SwordSite &site = table.sites[i];
+      fprintf(sitefile, SITEFILE_FORMAT, table.base + i, site.size_type, site.line,
+              site.column, site.function, site.file);
+    }
+  }
+  fclose(sitefile);
+}
+
+// size_type of every site, indexed by site id, for the in-process analysis.
+static std::vector<uint8_t> site_size_types() {
+  std::vector<uint8_t> size_types;
+  for(const SiteTable &table : site_tables()) {
+    size_types.resize(table.base + table.count, 0);
+    for(uint32_t i = 0; i < table.count; i++)
+      size_types[table.base + i] = table.sites[i].size_type;
+  }
+  return size_types;
+}
+
 extern "C" {
 
 #include "sword_interface.inl"
@@ -156,40 +405,32 @@ extern "C" {
                                             ompt_data_t *thread_data) {
     __sword_tid__ = my_next_id();
 
-    __sword_accesses1__ = new std::vector<TraceItem>(NUM_OF_ACCESSES);
-    __sword_accesses2__ = new std::vector<TraceItem>(NUM_OF_ACCESSES);
+    __sword_ring__ = new BufferRing(sword_buffers, sword_flags->ring_depth);
     set.reserve(SET_SIZE);
-    __sword_accesses__ = __sword_accesses1__;
-    out = (unsigned char *) malloc(OUT_LEN);
-
-    // Create datafile
-    std::string filename = sword_flags->traces_path + "/datafile_" + std::to_string(__sword_tid__);
-    __sword_datafile__ = fopen(filename.c_str(), "ab");
-    if (!__sword_datafile__) {
-      INFO(std::cerr, "SWORD: Error opening datafile: " << filename << " - " << strerror(errno) << ".");
-      exit(-1);
-    }
+    __sword_accesses__ = &__sword_ring__->get()->accesses;
+    __sword_buffer__ = (char *) __sword_accesses__->data();
+    __sword_block_items__ = sword_adapt.items();
+
+    __sword_stream__ = sword_container->stream(__sword_tid__);
+    __sword_published__ = 0;
     __sword_file_offset_begin__ = 0;
     __sword_file_offset_end__ = 0;
-
-    // Create metafile
-    filename = sword_flags->traces_path + "/metafile_" + std::to_string(__sword_tid__);
-    __sword_metafile__ = fopen(filename.c_str(), "a");
-    if (!__sword_metafile__) {
-      INFO(std::cerr, "SWORD: Error opening metafile: " << filename << " - " << strerror(errno) << ".");
-      exit(-1);
-    }
-    // fprintf(metafile, "#parallel_id,parent_parallel_id,bid,offset,span,level,file_offset_begin,file_offset_end\n");
     __sword_offset__ = 0;
     __sword_span__ = 0;
 
-    fut = std::async(dummy);
+    __sword_queue__ = new JobQueue();
+    sword_pool->attach(__sword_queue__, __sword_tid__);
   }
 
   static void on_ompt_callback_thread_end(ompt_data_t *thread_data)
   {
-    fclose(__sword_datafile__);
-    fclose(__sword_metafile__);
+    sword_pool->wait(__sword_queue__);
+    sword_pool->detach(__sword_queue__);
+    delete __sword_queue__;
+    sword_ring_dry += __sword_ring__->dry;
+    sword_blocks += __sword_ring__->blocks;
+    __sword_ring__->release(sword_buffers);
+    delete __sword_ring__;
   }
 
   static void on_ompt_callback_parallel_begin(ompt_data_t *parent_task_data,
@@ -207,6 +448,9 @@ extern "C" {
       ompt_id_t pid = ompt_get_unique_id();
       ParallelData *task_data = ToParallelData(parent_task_data);
       ParallelData *par_data = new ParallelData(pid, task_data->parallel_id, __sword_status__, omp_get_thread_num(), requested_team_size);
+      // Nested regions go to the trace files, so does the interval around.
+      if(__sword_interval__ && __sword_interval__->spill())
+        spill_held();
       if(__sword_span__ != 0) {
         __sword_offset__ += __sword_span__;
         __sword_span__ = requested_team_size;
@@ -240,20 +484,25 @@ extern "C" {
       if(__sword_status__ == 1) {
         __sword_bid__ = 0;
 
+        flush_runs();
         DUMPNOCHECK_TO_FILE
-          fut.wait();
-        fprintf(__sword_metafile__, "%lu,%lu,%lu,%u,%u,%d,%lu,%lu\n", par_data->parallel_id, par_data->parent_parallel_id, __sword_bid__, omp_get_thread_num(), team_size, par_data->level, __sword_file_offset_begin__, __sword_file_offset_end__);
+        record_interval(par_data->parallel_id, par_data->parent_parallel_id, omp_get_thread_num(), team_size, par_data->level);
+        publish_interval(team_size);
+        next_sampling_interval();
+        if(sword_inprocess)
+          __sword_interval__ = sword_inprocess->join(par_data->parallel_id, 0, team_size);
         if(__sword_span__ == 0) {
           __sword_offset__ = omp_get_thread_num();
           __sword_span__ = team_size;
         }
-
-        __sword_file_offset_begin__ = __sword_file_offset_end__;
       }
     } else { // ompt_scope_end
       ParallelData *tsk_data = ToParallelData(task_data);
       assert(tsk_data->freed == 0 && "Implicit task end should only be called once!");
       tsk_data->freed = 1;
+      // The interval after the last barrier of the region.
+      if(tsk_data->level == 1)
+        close_interval(false);
       delete tsk_data;
       __sword_status__--;
     }
@@ -266,10 +515,17 @@ extern "C" {
                                            const void *codeptr_ra) {
     if(endpoint == ompt_scope_begin) {
       ParallelData *par_data = (ParallelData *) task_data->ptr;
+      flush_runs();
       DUMPNOCHECK_TO_FILE
-        fut.wait();
-      fprintf(__sword_metafile__, "%lu,%lu,%lu,%u,%u,%d,%lu,%lu\n", par_data->parallel_id, par_data->parent_parallel_id, __sword_bid__, __sword_offset__, __sword_span__, par_data->level, __sword_file_offset_begin__, __sword_file_offset_end__);
-      __sword_file_offset_begin__ = __sword_file_offset_end__;
+      // All the threads of the team meet at a barrier, the in-process
+      // intervals end there only.
+      bool barrier = (kind != ompt_sync_region_taskwait && kind != ompt_sync_region_taskgroup);
+      bool analyzed = barrier && (par_data->level == 1) && close_interval(true);
+      if(!analyzed) {
+        record_interval(par_data->parallel_id, par_data->parent_parallel_id, __sword_offset__, __sword_span__, par_data->level);
+        publish_interval(omp_get_num_threads());
+      }
+      next_sampling_interval();
       __sword_bid__++;
     }
   }
@@ -277,6 +533,7 @@ extern "C" {
   static void on_ompt_callback_mutex_acquired(ompt_mutex_kind_t kind,
                                               ompt_wait_id_t wait_id,
                                               const void *codeptr_ra) {
+    flush_runs();
     (*__sword_accesses__)[__sword_idx__] = TraceItem(mutex_acquired, MutexRegion(kind, wait_id));
     DUMP_TO_FILE
       }
@@ -284,6 +541,7 @@ extern "C" {
   static void on_ompt_callback_mutex_released(ompt_mutex_kind_t kind,
                                               ompt_wait_id_t wait_id,
                                               const void *codeptr_ra) {
+    flush_runs();
     (*__sword_accesses__)[__sword_idx__] = TraceItem(mutex_released, MutexRegion(kind, wait_id));
     DUMP_TO_FILE
       }
@@ -342,13 +600,47 @@ do {                                                          \
     }
     boost::filesystem::create_directory(str);
 
-#if defined(LZO)
-    if(lzo_init() != LZO_E_OK) {
+    if(!codec_init()) {
       printf("internal error - lzo_init() failed !!!\n");
       printf("(this usually indicates a compiler bug - try recompiling\nwithout optimizations, and enable '-DLZO_DEBUG' for diagnostics)\n");
       exit(-1);
     }
-#endif
+
+    sword_access_runs = sword_flags->access_runs;
+    sword_sampling = sword_flags->sampling;
+    sword_sampling_period = sword_flags->sampling_period;
+    sword_adapt.init(sword_flags->adaptive, sword_flags->codec, sword_flags->codec_level,
+                     sword_flags->ring_depth, sword_flags->traces_path);
+    sword_buffers = new BufferPool();
+    sword_container = new TraceContainer();
+    if(!sword_container->open(sword_flags->traces_path, sword_flags->extent_size)) {
+      INFO(std::cerr, "SWORD: Error opening " << sword_container->filename << " - " << strerror(errno) << ".");
+      exit(-1);
+    }
+    sword_pool = new CompressionPool(sword_flags->compression_threads, sword_flags->compression_cpus);
+    if(sword_flags->inprocess && !inprocess_available()) {
+      INFO(std::cerr, "SWORD: The run-time has been built without INPROCESS, the traces are left for the offline analysis.");
+    } else if(sword_flags->inprocess) {
+      if(sword_flags->online)
+        INFO(std::cerr, "SWORD: inprocess=1 analyzes the barrier intervals, online=1 is ignored.");
+      boost::filesystem::create_directories(sword_flags->report_path);
+      sword_inprocess = new InProcessAnalyzer(sword_flags->inprocess_threads, sword_flags->inprocess_cpus,
+                                              sword_flags->inprocess_memory, sword_flags->report_path);
+      std::unique_lock<std::mutex> lock(smtx);
+      sword_inprocess->set_sites(site_size_types());
+    } else if(sword_flags->online) {
+      // The daemon needs the sites as soon as it reads the blocks.
+      dump_sites();
+      std::vector<std::string> args = { "--report-path", sword_flags->report_path };
+      if(!sword_flags->online_cpus.empty())
+        args.insert(args.end(), { "--cpus", sword_flags->online_cpus });
+      sword_online = new OnlinePublisher();
+      if(!sword_online->open(sword_flags->traces_path, sword_flags->online_traces, args)) {
+        INFO(std::cerr, "SWORD: Error starting " << ONLINE_DAEMON << " - " << strerror(errno) << ", the traces are left for the offline analysis.");
+        delete sword_online;
+        sword_online = NULL;
+      }
+    }
 
     // INFO(std::cout, "SIZE:" << sizeof(TraceItem));
     // INFO(std::cout, "SIZE ACCESS:" << sizeof(Access));
@@ -366,13 +658,51 @@ do {                                                          \
   }
 
   void ompt_finalize(ompt_data_t *tool_data) {
+    sword_pool->stop();
+    if(!sword_container->finalize())
+      INFO(std::cerr, "SWORD: Error finalizing " << sword_container->filename << " - " << strerror(errno) << ".");
+    dump_sites();
     fflush(NULL);
+    // sword-analysisd finishes with the intervals left and the sitefile.
+    int online_status = -1;
+    if(sword_online)
+      online_status = sword_online->close();
+    if(sword_inprocess) {
+      size_t nraces = sword_inprocess->finalize();
+      boost::filesystem::path sites = boost::filesystem::path(sword_flags->traces_path) / SITEFILE;
+      if(boost::filesystem::exists(sites))
+        boost::filesystem::copy_file(sites, boost::filesystem::path(sword_flags->report_path) / SITEFILE,
+                                     boost::filesystem::copy_option::overwrite_if_exists);
+      INFO(std::cerr, "SWORD: The in-process analysis analyzed " << sword_inprocess->analyzed << " barrier intervals and found " << nraces << " data race(s), with at most " << sword_inprocess->peak / (1 << 20) << " MB of traces in memory.");
+      if(sword_inprocess->spilled > 0)
+        INFO(std::cerr, "SWORD: " << sword_inprocess->spilled << " barrier intervals did not fit in inprocess_memory and are left for the offline analysis.");
+      if(sword_inprocess->overdraft > 0)
+        INFO(std::cerr, "SWORD: The barrier intervals already handed over went " << sword_inprocess->overdraft / (1 << 20) << " MB beyond inprocess_memory.");
+    }
+
+    if(sword_pool->saturated > 0)
+      INFO(std::cerr, "SWORD: The compression threads were saturated " << sword_pool->saturated << " times, consider increasing compression_threads.");
+    if(sword_adapt.isEnabled()) {
+      CodecSetting setting = sword_adapt.setting();
+      INFO(std::cerr, "SWORD: The adaptive compression changed setting " << sword_adapt.decisions << " times, last codec " << codec_name(setting.codec) << " with " << sword_adapt.items() << " accesses per block, see " << ADAPT_FILE << ".");
+    }
+    sword_adapt.finalize();
+    if(sword_sampling && sword_sampled_out > 0)
+      INFO(std::cerr, "SWORD: The sampling recorded " << sword_recorded << " of " << sword_recorded + sword_sampled_out << " accesses, the analysis reports the coverage of every parallel region.");
+    if(sword_ring_dry > 0)
+      INFO(std::cerr, "SWORD: The trace buffer ring ran dry " << sword_ring_dry << " times in " << sword_blocks << " blocks, consider increasing ring_depth.");
 
     std::cout << std::endl;
     std::cout << "################################################################" << std::endl;
     std::cout << std::endl << "SWORD data gathering terminated." << std::endl;
     std::cout << std::endl << "Logs are stored in \"" << sword_flags->traces_path << "\"." << std::endl;
     std::cout << std::endl;
+    if(online_status == 0 || (sword_inprocess && sword_inprocess->spilled == 0)) {
+      std::cout << "The races have been analyzed " << (sword_inprocess ? "in-process" : "online") << ", to print the results please execute:" << std::endl << std::endl;
+      std::cout << "\tsword-print-report --executable " << __progname << " --report-path " << sword_flags->report_path << std::endl;
+      std::cout << std::endl << "################################################################" << std::endl << std::endl;
+      return;
+    }
     std::cout << "To analyze the data and detect races, please execute:" << std::endl << std::endl;
     std::cout << "\tsword-offline-analysis --analysis-tool sword-race-analysis --executable " << __progname << " --traces-path ./sword_data --report-path ./sword_report" << std::endl; 
     std::cout  << std::endl << std::endl << "To print the results of the analysis, please execute:" << std::endl << std::endl;
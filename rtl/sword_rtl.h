@@ -13,13 +13,19 @@
 #ifndef SWORD_RTL_H
 #define SWORD_RTL_H
 
+#include "sword_adapt.h"
 #include "sword_common.h"
+#include "sword_filter.h"
 #include "sword_hashset.h"
+#include "sword_inprocess.h"
+#include "sword_online.h"
+#include "sword_pool.h"
+#include "sword_runs.h"
+#include "sword_sampling.h"
 
 #include <fcntl.h>
 #include <sys/stat.h>
 
-#include <future>
 #include <vector>
 
 #define ALWAYS_INLINE			__attribute__((always_inline))
@@ -82,23 +88,44 @@ struct ParallelData {
 extern thread_local int __sword_tid__;
 extern thread_local int __sword_status__;
 thread_local std::vector<TraceItem> *__sword_accesses__;
-thread_local std::vector<TraceItem> *__sword_accesses1__;
-thread_local std::vector<TraceItem> *__sword_accesses2__;
+thread_local BufferRing *__sword_ring__;
 extern thread_local uint64_t __sword_idx__;
+// Accesses per block, set by the adaptive controller when a block starts.
+thread_local uint64_t __sword_block_items__;
 extern thread_local uint64_t __sword_bid__;
 thread_local char *__sword_buffer__;
 extern thread_local unsigned __sword_offset__;
 extern thread_local unsigned __sword_span__;
 extern thread_local size_t __sword_file_offset_begin__;
 extern thread_local size_t __sword_file_offset_end__;
-thread_local FILE *__sword_datafile__;
-thread_local FILE *__sword_metafile__;
+thread_local TraceStream *__sword_stream__;
+// Blocks of the stream handed to sword-analysisd, with online=1.
+thread_local size_t __sword_published__;
+// Barrier interval of the in-process analysis the thread records, NULL if
+// its blocks go to the trace files, and the items it holds for it.
+thread_local InProcessInterval *__sword_interval__;
+thread_local std::vector<TraceItem> __sword_held__;
 extern const char *__progname;
 
+// Filter of the accesses already recorded in the current block, selected
+// with the DEDUP CMake variable.
+#if defined(DEDUP_DIRECT)
+typedef direct_filter fast_set;
+#define DEDUP_CHECK_INSERT(item) set.check_insert(item.data.access)
+#define DEDUP_CHECK_INSERT_SITE(item) set.check_insert(item.data.site_access)
+#elif defined(DEDUP_TWOWAY)
+typedef twoway_filter fast_set;
+#define DEDUP_CHECK_INSERT(item) set.check_insert(item.data.access)
+#define DEDUP_CHECK_INSERT_SITE(item) set.check_insert(item.data.site_access)
+#else
 typedef emilib::HashSet<uint64_t, NUM_OF_ACCESSES> fast_set;
+#define DEDUP_CHECK_INSERT(item) set.check_insert(hash_value(item))
+#define DEDUP_CHECK_INSERT_SITE(item) set.check_insert(hash_value(item))
+#endif
 thread_local fast_set set;
 
-thread_local unsigned char *out;
-thread_local std::future<bool> fut;
+thread_local JobQueue *__sword_queue__;
+thread_local RunDetector __sword_runs__;
+thread_local SiteSampler __sword_sampler__;
 
 #endif  // SWORD_RTL_H
@@ -0,0 +1,104 @@
+//===-- sword_runs.h -----------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Record-time detection of strided runs. Every thread keeps a few open
+// runs in a small two-way table, keyed by pc and size_type (or site). An
+// access that continues the arithmetic progression of its run only bumps
+// the count, anything else closes a run (its own, or the oldest of its
+// set), which is written as its first access followed by an access_run
+// item if it has more than one element.
+// Open runs are closed before anything that changes the lockset or ends a
+// barrier interval is recorded, so all the accesses of a run share them.
+//===----------------------------------------------------------------------===//
+
+#ifndef SWORD_RUNS_H
+#define SWORD_RUNS_H
+
+#include "sword_common.h"
+
+#include <string.h>
+
+#include <utility>
+
+#define RUN_LOG_SETS			3
+#define RUN_SLOTS				(2 << RUN_LOG_SETS)
+// The analysis keeps the stride of an interval in 32 bits.
+#define RUN_MAX_STRIDE			(1LL << 30)
+#define RUN_MAX_COUNT			UINT32_MAX
+
+// Plain storage for the first access, so that the thread_local detector
+// needs no dynamic initialization.
+struct RunSlot {
+  unsigned char first[sizeof(TraceItem)];
+  uint64_t key;
+  uint64_t last_address;
+  int64_t stride;
+  uint32_t count; // 0 if the slot is empty
+
+  void reset(const TraceItem &item, uint64_t k, uint64_t address) {
+    memcpy(first, &item, sizeof(TraceItem));
+    key = k;
+    last_address = address;
+    stride = 0;
+    count = 1;
+  }
+
+  const TraceItem &getFirst() const {
+    return *reinterpret_cast<const TraceItem *>(first);
+  }
+};
+
+// Zero-initialized as a thread_local.
+class RunDetector {
+ public:
+  RunSlot slots[RUN_SLOTS];
+
+  // Key of an access, site keys cannot clash with pc keys because 0xFF is
+  // not a valid size_type.
+  static uint64_t key(const Access &a) {
+    return (a.getPC() << 8) | a.getAccessSizeType();
+  }
+
+  static uint64_t key(const SiteAccess &a) {
+    return ((uint64_t) a.getSite() << 8) | 0xFF;
+  }
+
+  // Returns NULL if the access has been absorbed by its run, otherwise the
+  // slot to start a new run in, whose run must be written before reset().
+  RunSlot *add(uint64_t k, uint64_t address) {
+    RunSlot *ways = &slots[2 * ((k * 0x9E3779B97F4A7C15ULL) >> (64 - RUN_LOG_SETS))];
+    RunSlot *s = ways;
+    if(s->count == 0 || s->key != k) {
+      s = ways + 1;
+      if(s->count == 0 || s->key != k) {
+        // Evict the older way, the newer one moves to the second way.
+        if(ways[0].count != 0)
+          std::swap(ways[0], ways[1]);
+        return ways;
+      }
+    }
+    int64_t delta = (int64_t) (address - s->last_address);
+    if(delta == 0)
+      return NULL; // same access, same lockset
+    if(s->count == 1) {
+      if(delta <= -RUN_MAX_STRIDE || delta >= RUN_MAX_STRIDE)
+        return s;
+      s->stride = delta;
+    } else if(delta != s->stride || s->count == RUN_MAX_COUNT) {
+      return s;
+    }
+    s->count++;
+    s->last_address = address;
+    return NULL;
+  }
+};
+
+#endif  // SWORD_RUNS_H
@@ -0,0 +1,85 @@
+//===-- sword_sampling.h -------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Per-site sampling of the accesses (sampling=1), LiteRace-style: cold code
+// is traced fully, hot loops sparsely. Every thread keeps a sampler per
+// access site, keyed like the runs (pc and size_type, or site), in a
+// direct-mapped table. A site starts at a sampling period of 1, and its
+// period doubles every SAMPLE_BURST recorded executions, up to the
+// sampling_period option. The samplers belong to a barrier interval: the
+// epoch of the thread moves at every barrier, which resets the rate of all
+// its sites at once.
+// Only single accesses are sampled, mutex and barrier events, ranges and
+// the accesses appended inline by the pass are always recorded. The
+// recorded and sampled-out accesses of a barrier interval are stored in its
+// IntervalRecord, so the analysis can state its coverage.
+//===----------------------------------------------------------------------===//
+
+#ifndef SWORD_SAMPLING_H
+#define SWORD_SAMPLING_H
+
+#include <stdint.h>
+
+#define SAMPLE_LOG_SLOTS		10
+#define SAMPLE_SLOTS			(1 << SAMPLE_LOG_SLOTS)
+#define SAMPLE_BURST			32
+#define DEFAULT_SAMPLE_PERIOD	1024
+
+struct SampleSlot {
+  uint64_t key;
+  uint32_t epoch;
+  uint32_t period;    // 0 if the slot is empty
+  uint32_t countdown; // executions to the next recorded one
+  uint32_t recorded;
+};
+
+// Zero-initialized as a thread_local.
+class SiteSampler {
+ private:
+  SampleSlot slots[SAMPLE_SLOTS];
+  uint32_t epoch;
+
+ public:
+  // Accesses of the current barrier interval.
+  uint64_t recorded;
+  uint64_t sampled_out;
+
+  // Returns true if this execution of the site has to be recorded. A site
+  // that lost its slot to another one starts over at period 1.
+  bool sample(uint64_t key, uint32_t max_period) {
+    SampleSlot *s = &slots[(key * 0x9E3779B97F4A7C15ULL) >> (64 - SAMPLE_LOG_SLOTS)];
+    if(s->key != key || s->epoch != epoch || s->period == 0) {
+      s->key = key;
+      s->epoch = epoch;
+      s->period = 1;
+      s->countdown = 1;
+      s->recorded = 0;
+    }
+    if(--s->countdown > 0) {
+      sampled_out++;
+      return false;
+    }
+    if(++s->recorded % SAMPLE_BURST == 0 && s->period < max_period)
+      s->period *= 2;
+    s->countdown = s->period;
+    recorded++;
+    return true;
+  }
+
+  // At a barrier, after the counters have been stored in the interval.
+  void next_interval() {
+    epoch++;
+    recorded = 0;
+    sampled_out = 0;
+  }
+};
+
+#endif  // SWORD_SAMPLING_H
@@ -0,0 +1,335 @@
+//===-- sword_tcgen.h ----------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Trace-specific codec in the spirit of TCgen: every field of an item is
+// predicted from the previous items, and only the outcome of the
+// prediction and the residual of a miss are written, with a binary range
+// coder whose probabilities adapt within the block:
+//
+//   type        order-1 context of the previous type
+//   pc / site   pc -> next pc table, bytes of the pc on a miss
+//   size_type   last size_type of the pc
+//   address     per pc: stride (last + last delta), DFCM (last + delta that
+//               followed the last two deltas) and last value, residual of
+//               the stride prediction on a miss
+//   other items bytes of the payload, in the context of the type
+//
+// It works on raw blocks (BlockEncoder with block_raw), whose items it
+// understands; the model is reset for every block so that blocks decode
+// independently. Compressed block: varint n | range coder bytes.
+//===----------------------------------------------------------------------===//
+
+#ifndef SWORD_TCGEN_H
+#define SWORD_TCGEN_H
+
+#include "sword_block.h"
+#include "sword_common.h"
+
+#include <string.h>
+
+#include <memory>
+
+#define TC_PROB_BITS			11
+#define TC_PROB_ONE				(1 << TC_PROB_BITS)
+#define TC_MOVE_BITS			5
+#define TC_TOP					(1U << 24)
+#define TC_LOG_TABLE			12
+#define TC_TYPES				16
+
+typedef uint16_t tc_prob;
+
+class TcgenRangeEncoder {
+ private:
+  uint64_t low;
+  uint32_t range;
+  uint8_t cache;
+  uint64_t cache_size;
+  unsigned char *out;
+  unsigned char *end;
+
+  void put(unsigned char b) {
+    if(out < end)
+      *out = b;
+    out++;
+  }
+
+  void shift_low() {
+    if((uint32_t) low < 0xFF000000U || (low >> 32) != 0) {
+      uint8_t carry = low >> 32;
+      uint8_t temp = cache;
+      do {
+        put(temp + carry);
+        temp = 0xFF;
+      } while(--cache_size != 0);
+      cache = (uint8_t) (low >> 24);
+    }
+    cache_size++;
+    low = (low & 0x00FFFFFF) << 8;
+  }
+
+ public:
+  TcgenRangeEncoder(unsigned char *dst, size_t capacity)
+    : low(0), range(0xFFFFFFFFU), cache(0), cache_size(1), out(dst), end(dst + capacity) {}
+
+  unsigned bit(tc_prob *p, unsigned b) {
+    uint32_t bound = (range >> TC_PROB_BITS) * *p;
+    if(!b) {
+      range = bound;
+      *p += (TC_PROB_ONE - *p) >> TC_MOVE_BITS;
+    } else {
+      low += bound;
+      range -= bound;
+      *p -= *p >> TC_MOVE_BITS;
+    }
+    while(range < TC_TOP) {
+      range <<= 8;
+      shift_low();
+    }
+    return b;
+  }
+
+  // Returns the end of the output, NULL if it did not fit.
+  unsigned char *finish() {
+    for(int i = 0; i < 5; i++)
+      shift_low();
+    return (out <= end) ? out : NULL;
+  }
+};
+
+class TcgenRangeDecoder {
+ private:
+  uint32_t range;
+  uint32_t code;
+  const unsigned char *in;
+  const unsigned char *end;
+
+  unsigned char next() {
+    if(in < end)
+      return *in++;
+    truncated = true;
+    return 0;
+  }
+
+ public:
+  bool truncated;
+
+  TcgenRangeDecoder(const unsigned char *src, size_t len)
+    : range(0xFFFFFFFFU), code(0), in(src), end(src + len), truncated(false) {
+    for(int i = 0; i < 5; i++)
+      code = (code << 8) | next();
+  }
+
+  unsigned bit(tc_prob *p, unsigned) {
+    uint32_t bound = (range >> TC_PROB_BITS) * *p;
+    unsigned b;
+    if(code < bound) {
+      range = bound;
+      *p += (TC_PROB_ONE - *p) >> TC_MOVE_BITS;
+      b = 0;
+    } else {
+      code -= bound;
+      range -= bound;
+      *p -= *p >> TC_MOVE_BITS;
+      b = 1;
+    }
+    while(range < TC_TOP) {
+      range <<= 8;
+      code = (code << 8) | next();
+    }
+    return b;
+  }
+};
+
+// Codes the nbits (at most 8) low bits of v with a bit tree, returns them;
+// the decoder ignores v.
+template<class C>
+static inline unsigned tc_tree(C &c, tc_prob *probs, unsigned nbits, unsigned v) {
+  unsigned m = 1;
+  for(int i = nbits - 1; i >= 0; i--)
+    m = (m << 1) | c.bit(&probs[m], (v >> i) & 1);
+  return m - (1 << nbits);
+}
+
+// Codes the nbytes low bytes of v, most significant first.
+template<class C>
+static inline uint64_t tc_bytes(C &c, tc_prob (*probs)[256], unsigned nbytes, uint64_t v) {
+  uint64_t r = 0;
+  for(int i = nbytes - 1; i >= 0; i--)
+    r = (r << 8) | tc_tree(c, probs[i], 8, (v >> (8 * i)) & 0xFF);
+  return r;
+}
+
+static inline size_t tc_hash(uint64_t v) {
+  return (v * 0x9E3779B97F4A7C15ULL) >> (64 - TC_LOG_TABLE);
+}
+
+// Predictors of the accesses of one pc or site.
+struct TcgenSlot {
+  uint64_t last;
+  int64_t d1;
+  int64_t d2;
+  uint8_t size_type;
+  uint8_t selector;
+};
+
+class TcgenModel {
+ private:
+  // Predictors.
+  uint64_t next_key[1 << TC_LOG_TABLE];
+  TcgenSlot slots[1 << TC_LOG_TABLE];
+  int64_t dfcm[1 << TC_LOG_TABLE];
+  uint64_t prev_key;
+  unsigned prev_type;
+  unsigned prev_hit;
+
+  // Probabilities.
+  tc_prob type_probs[TC_TYPES][256];
+  tc_prob key_hit[2][2];
+  tc_prob key_bytes[2][6][256];
+  tc_prob size_type_hit[2];
+  tc_prob size_type_probs[256];
+  tc_prob selector_probs[4][4];
+  tc_prob residual_len[4][16];
+  tc_prob residual_bytes[8][256];
+  tc_prob payload[TC_TYPES][PAYLOAD_SIZE][256];
+
+ public:
+  void reset() {
+    memset(next_key, 0, sizeof(next_key));
+    memset(slots, 0, sizeof(slots));
+    memset(dfcm, 0, sizeof(dfcm));
+    prev_key = 0;
+    prev_type = 0;
+    prev_hit = 0;
+    tc_prob *first = &type_probs[0][0];
+    tc_prob *last = (tc_prob *) ((char *) &payload + sizeof(payload));
+    for(tc_prob *p = first; p < last; p++)
+      *p = TC_PROB_ONE / 2;
+  }
+
+  // Codes one item: the encoder reads it, the decoder writes it.
+  template<class C>
+  void code(C &c, TraceItem *item) {
+    unsigned type = tc_tree(c, type_probs[prev_type % TC_TYPES], 8, item->getType());
+    prev_type = type;
+
+    if(!is_access(type)) {
+      unsigned char *p = (unsigned char *) &item->data;
+      for(unsigned j = 0; j < PAYLOAD_SIZE; j++)
+        p[j] = tc_tree(c, payload[type % TC_TYPES][j], 8, p[j]);
+      item->setType((CallbackType) type);
+      return;
+    }
+
+    bool is_data = (type == data_access);
+    uint64_t key = is_data ? item->data.access.getPC() : item->data.site_access.getSite();
+    uint64_t *predicted = &next_key[tc_hash(prev_key)];
+    unsigned hit = c.bit(&key_hit[is_data][prev_hit], key == *predicted);
+    if(hit)
+      key = *predicted;
+    else
+      key = tc_bytes(c, key_bytes[is_data], is_data ? 6 : 4, key);
+    *predicted = key;
+    prev_key = key;
+    prev_hit = hit;
+
+    TcgenSlot *s = &slots[tc_hash(is_data ? key : ~key)];
+    uint8_t size_type = 0;
+    if(is_data) {
+      size_type = item->data.access.getAccessSizeType();
+      if(c.bit(&size_type_hit[s->size_type == 0], size_type == s->size_type))
+        size_type = s->size_type;
+      else
+        size_type = tc_tree(c, size_type_probs, 8, size_type);
+      s->size_type = size_type;
+    }
+
+    uint64_t address = is_data ? item->data.access.getAddress() : item->data.site_access.getAddress();
+    int64_t *dfcm_delta = &dfcm[tc_hash(s->d1 * 31 + s->d2)];
+    uint64_t candidates[3] = { s->last + s->d1, s->last + *dfcm_delta, s->last };
+    unsigned selector = 3;
+    for(unsigned k = 0; k < 3; k++) {
+      if(address == candidates[k]) {
+        selector = k;
+        break;
+      }
+    }
+    selector = tc_tree(c, selector_probs[s->selector], 2, selector);
+    if(selector < 3) {
+      address = candidates[selector];
+    } else {
+      uint64_t r = zigzag(address - candidates[0]);
+      unsigned nbytes = 0;
+      while(nbytes < 8 && (r >> (8 * nbytes)) != 0)
+        nbytes++;
+      nbytes = tc_tree(c, residual_len[s->selector], 4, nbytes);
+      r = tc_bytes(c, residual_bytes, nbytes, r);
+      address = candidates[0] + unzigzag(r);
+    }
+    int64_t delta = (int64_t) (address - s->last);
+    *dfcm_delta = delta;
+    s->d2 = s->d1;
+    s->d1 = delta;
+    s->last = address;
+    s->selector = selector;
+
+    item->setType((CallbackType) type);
+    item->data.access = Access();
+    if(is_data) {
+      item->data.access.size_type = size_type;
+      item->data.access.address = address;
+      item->data.access.pc.num = key;
+    } else {
+      item->data.site_access = SiteAccess((uint32_t) key, address);
+    }
+  }
+};
+
+// Compresses a raw block of len bytes into dst, returns the compressed size
+// or 0 if the block is not raw or does not fit in capacity bytes.
+static size_t tcgen_compress(const unsigned char *src, size_t len, unsigned char *dst, size_t capacity) {
+  if(len < 1 || src[0] != block_raw || (len - 1) % sizeof(TraceItem) != 0 || capacity < VARINT_MAX)
+    return 0;
+  thread_local std::unique_ptr<TcgenModel> model(new TcgenModel());
+  model->reset();
+  size_t n = (len - 1) / sizeof(TraceItem);
+  unsigned char *p = put_varint(dst, n);
+  TcgenRangeEncoder rc(p, capacity - (p - dst));
+  for(size_t i = 0; i < n; i++) {
+    TraceItem item;
+    memcpy(&item, src + 1 + i * sizeof(TraceItem), sizeof(TraceItem));
+    model->code(rc, &item);
+  }
+  unsigned char *end = rc.finish();
+  return end ? end - dst : 0;
+}
+
+// Decompresses into a raw block, returns its size or -1.
+static long tcgen_decompress(const unsigned char *src, size_t len, unsigned char *dst, size_t capacity) {
+  uint64_t n;
+  const unsigned char *p = get_varint(src, src + len, &n);
+  if(!p || n > NUM_OF_ACCESSES || 1 + n * sizeof(TraceItem) > capacity)
+    return -1;
+  thread_local std::unique_ptr<TcgenModel> model(new TcgenModel());
+  model->reset();
+  TcgenRangeDecoder rc(p, len - (p - src));
+  dst[0] = block_raw;
+  for(size_t i = 0; i < n; i++) {
+    TraceItem item;
+    model->code(rc, &item);
+    memcpy(dst + 1 + i * sizeof(TraceItem), &item, sizeof(TraceItem));
+  }
+  if(rc.truncated)
+    return -1;
+  return 1 + n * sizeof(TraceItem);
+}
+
+#endif  // SWORD_TCGEN_H
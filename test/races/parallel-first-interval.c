@@ -0,0 +1,35 @@
+// RUN: %libsword-compile-and-run-race 2>&1 | FileCheck %s
+#include <omp.h>
+#include <stdio.h>
+
+#define N 1000
+
+int a[8 * N];
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  // The race is in barrier interval 0, which every thread records twice.
+  for(int r = 0; r < 20; r++) {
+    #pragma omp parallel num_threads(8) shared(var)
+    {
+      var++;
+      #pragma omp barrier
+      for(int i = 0; i < N; i++)
+        a[omp_get_thread_num() * N + i] = r;
+    }
+  }
+
+  int error = (var == 0);
+  return error;
+}
+
+// CHECK-NOT: parallel-first-interval.c:20
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-first-interval.c:17:10
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-first-interval.c:17:10
+// CHECK: --------------------------------------------------
+// CHECK-NOT: parallel-first-interval.c:20
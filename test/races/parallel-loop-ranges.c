@@ -0,0 +1,42 @@
+// RUN: %clang-sword %static-analysis-flags %openmp_flags %sword_flags %flags -mllvm -sword-loop-ranges %s -S -emit-llvm -o - | FileCheck --check-prefix=IR %s
+// RUN: %clang-sword %static-analysis-flags %openmp_flags %sword_flags %flags -mllvm -sword-loop-ranges %s -o %t %libsword-libs
+// RUN: env SWORD_OPTIONS="traces_path=%t_sword_data access_runs=0" %t && %libsword-analyze 2>&1 | FileCheck %s
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=BLOCKS %s
+#include <omp.h>
+#include <stdio.h>
+
+#define N 1000
+
+int a[3 * N];
+
+int main(int argc, char* argv[])
+{
+  // Every third element from a bound only known when the loop starts: the
+  // writes are {a + 4 * (3 * begin + 1),+,12}, end - begin of them.
+  #pragma omp parallel num_threads(2)
+  {
+    long begin = omp_get_thread_num() * (N / 4);
+    long end = begin + N / 2;
+    for(long i = begin; i < end; i++)
+      a[3 * i + 1] = i;
+  }
+
+  return 0;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-loop-ranges.c:21:20
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-loop-ranges.c:21:20
+// CHECK: --------------------------------------------------
+
+// The loop is recorded by one call before it, so without runs the trace
+// has a few items per thread rather than 500.
+// BLOCKS: SWORD: {{[0-9]+}} blocks, {{[0-9][0-9]?[0-9]?}} items,
+
+// IR-LABEL: define internal void @.omp_outlined.(
+// IR-NOT: call void @__sword_write4(
+// IR: call void @__sword_write_range4(i8* {{.*}}, i64 12, i64 {{.*}})
+// IR-NOT: call void @__sword_write4(
+// IR: ret void
@@ -0,0 +1,25 @@
+// RUN: %libsword-compile-and-run-race 2>&1 | FileCheck %s
+#include <omp.h>
+#include <stdio.h>
+#include <string.h>
+
+#define N 4096
+
+char src[N], dst[2 * N];
+
+int main(int argc, char* argv[])
+{
+  #pragma omp parallel num_threads(2)
+  {
+    memcpy(dst + omp_get_thread_num() * (N / 2), src, N);
+  }
+
+  return 0;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 16 in .omp_outlined.{{.*}} at {{.*}}parallel-memcpy.c:14:5
+// CHECK:     Write of size 16 in .omp_outlined.{{.*}} at {{.*}}parallel-memcpy.c:14:5
+// CHECK: --------------------------------------------------
@@ -0,0 +1,30 @@
+// RUN: %libsword-compile && env SWORD_OPTIONS="traces_path=%t_sword_data access_runs=0" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.items
+// RUN: FileCheck %s < %t.items
+// RUN: rm -rf %t_sword_report && env SWORD_OPTIONS="traces_path=%t_sword_data access_runs=1" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.runs
+// RUN: FileCheck %s < %t.runs
+// RUN: diff %t.items %t.runs
+#include <omp.h>
+#include <stdio.h>
+
+#define N 1000
+
+int main(int argc, char* argv[])
+{
+  int a[N];
+
+  #pragma omp parallel num_threads(2) shared(a)
+  {
+    int begin = omp_get_thread_num() * (N / 4);
+    for(int i = begin; i < begin + N / 2; i++)
+      a[i] = i;
+  }
+
+  return 0;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-overlap-runs.c:19:12
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-overlap-runs.c:19:12
+// CHECK: --------------------------------------------------
@@ -0,0 +1,47 @@
+// RUN: %clang-sword %static-analysis-flags %openmp_flags %sword_flags %flags -mllvm -sword-inline-fastpath %s -o %t %libsword-libs
+// RUN: rm -rf %t_sword_data && env SWORD_OPTIONS="traces_path=%t_sword_data adaptive=0" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.fixed
+// RUN: FileCheck %s < %t.fixed
+// RUN: not test -e %t_sword_data/adaptfile
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=FIXED %s
+// RUN: rm -rf %t_sword_report && env SWORD_OPTIONS="traces_path=%t_sword_data adaptive=1 compression_threads=1 ring_depth=2" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.adaptive
+// RUN: diff %t.fixed %t.adaptive
+// RUN: FileCheck --check-prefix=ADAPT %s < %t_sword_data/adaptfile
+// REQUIRES: x86_64
+#include <omp.h>
+#include <stdio.h>
+
+#define N 1000000
+
+int a[N];
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  // A single compression thread falls behind, so the controller changes
+  // the codec and shrinks the blocks, also under the inlined accesses.
+  #pragma omp parallel num_threads(4) shared(var)
+  {
+    var++;
+    for(int r = 0; r < 4; r++) {
+      #pragma omp for
+      for(int i = 0; i < N; i++)
+        a[i] = i + r;
+    }
+  }
+
+  int error = (var != 4);
+  return error;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-adaptive.c:25:8
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-adaptive.c:25:8
+// CHECK: --------------------------------------------------
+
+// Without the controller the blocks keep the default codec and nothing is
+// logged, with it every decision goes to the adaptfile.
+// FIXED: SWORD: {{[0-9]+}} blocks, {{[0-9]+}} items, codecs: lzo {{[0-9]+}}, formats:
+// ADAPT: #time_ms,codec,level,block_items,backlog,cpu_ratio,latency_us,ratio,reason
@@ -0,0 +1,47 @@
+// RUN: %libsword-compile && env SWORD_OPTIONS="traces_path=%t_sword_data codec=none access_runs=0" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.none
+// RUN: FileCheck %s < %t.none
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=NONE %s
+// RUN: rm -rf %t_sword_report && env SWORD_OPTIONS="traces_path=%t_sword_data codec=lzo access_runs=0" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.lzo
+// RUN: diff %t.none %t.lzo
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=LZO %s
+// RUN: rm -rf %t_sword_report && env SWORD_OPTIONS="traces_path=%t_sword_data codec=snappy access_runs=0" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.snappy
+// RUN: diff %t.none %t.snappy
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=SNAPPY %s
+// RUN: rm -rf %t_sword_report && env SWORD_OPTIONS="traces_path=%t_sword_data codec=lz4 access_runs=0" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.lz4
+// RUN: diff %t.none %t.lz4
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=LZ4 %s
+#include <omp.h>
+#include <stdio.h>
+
+#define N 100000
+
+int a[N];
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  // Several blocks per thread without runs, the report must not depend on
+  // the codec.
+  #pragma omp parallel num_threads(4) shared(var)
+  {
+    var++;
+    #pragma omp for
+    for(int i = 0; i < N; i++)
+      a[i] = i;
+  }
+
+  int error = (var != 4);
+  return error;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-codecs.c:28:8
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-codecs.c:28:8
+// CHECK: --------------------------------------------------
+// NONE: SWORD: {{[0-9]+}} blocks, {{[0-9]+}} items, codecs: none {{[0-9]+}}, formats:
+// LZO: SWORD: {{[0-9]+}} blocks, {{[0-9]+}} items, codecs: lzo {{[0-9]+}}, formats:
+// SNAPPY: SWORD: {{[0-9]+}} blocks, {{[0-9]+}} items, codecs: snappy {{[0-9]+}}, formats:
+// LZ4: SWORD: {{[0-9]+}} blocks, {{[0-9]+}} items, codecs: lz4 {{[0-9]+}}, formats:
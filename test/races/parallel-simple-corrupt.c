@@ -0,0 +1,26 @@
+// REQUIRES: linux, x86_64
+// The first block starts after the 4 KB header page, its data 48 bytes later.
+// RUN: %libsword-compile && env SWORD_OPTIONS="traces_path=%t_sword_data" %t
+// RUN: cp %t_sword_data/tracefile %t.tracefile
+// RUN: printf 'SWRD' | dd of=%t_sword_data/tracefile bs=1 seek=4144 conv=notrunc
+// RUN: not %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report 2>&1 | FileCheck %s
+// RUN: cp %t.tracefile %t_sword_data/tracefile && truncate -s -100 %t_sword_data/tracefile
+// RUN: not %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report 2>&1 | FileCheck --check-prefix=TRUNCATED %s
+#include <omp.h>
+#include <stdio.h>
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  #pragma omp parallel num_threads(2) shared(var)
+  {
+    var++;
+  }
+
+  int error = (var != 2);
+  return error;
+}
+
+// CHECK: Corrupt or truncated block at offset 0 of thread
+// TRUNCATED: SWORD: Error opening trace container
@@ -0,0 +1,39 @@
+// RUN: %clang-sword %static-analysis-flags %openmp_flags %sword_flags %flags -mllvm -sword-inline-fastpath %s -o %t %libsword-libs && %libsword-run 2>&1 | FileCheck %s
+// RUN: %clang-sword %static-analysis-flags %openmp_flags %sword_flags %flags -mllvm -sword-inline-fastpath %s -S -emit-llvm -o - | FileCheck --check-prefix=IR %s
+// REQUIRES: x86_64
+#include <omp.h>
+#include <stdio.h>
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  #pragma omp parallel num_threads(2) shared(var)
+  {
+    var++;
+  }
+
+  int error = (var != 2);
+  return error;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-fastpath.c:12:8
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-fastpath.c:12:8
+// CHECK: --------------------------------------------------
+
+// The write of var is appended to the buffer inline: size_type 0x21 (size4,
+// write), address and pc, then the index is bumped and the buffer flushed
+// when it is full.
+// IR-LABEL: define internal void @.omp_outlined.(
+// IR-NOT: {{^}}define
+// IR-NOT: call void @__sword_write4(
+// IR: store i8 33,
+// IR-NOT: {{^}}define
+// IR: asm sideeffect "leaq 0(%rip), $0", "=r"()
+// IR-NOT: {{^}}define
+// IR: store i64 {{.*}}, i64* @__sword_idx__
+// IR-NOT: {{^}}define
+// IR: call void @__sword_flush_buffer()
@@ -0,0 +1,23 @@
+// RUN: %libsword-compile && %libsword-inprocess-run 2>&1 | FileCheck %s
+// REQUIRES: inprocess
+#include <omp.h>
+#include <stdio.h>
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  #pragma omp parallel num_threads(2) shared(var)
+  {
+    var++;
+  }
+
+  return 0;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-inprocess.c:12:8
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-inprocess.c:12:8
+// CHECK: --------------------------------------------------
@@ -0,0 +1,22 @@
+// RUN: %libsword-compile && %libsword-online-run 2>&1 | FileCheck %s
+#include <omp.h>
+#include <stdio.h>
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  #pragma omp parallel num_threads(2) shared(var)
+  {
+    var++;
+  }
+
+  return 0;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-online.c:11:8
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-online.c:11:8
+// CHECK: --------------------------------------------------
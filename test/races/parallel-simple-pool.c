@@ -0,0 +1,34 @@
+// RUN: %libsword-compile && env SWORD_OPTIONS="traces_path=%t_sword_data compression_threads=1 compression_cpus=0 access_runs=0" %t && %libsword-analyze 2>&1 | FileCheck %s
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=BLOCKS %s
+#include <omp.h>
+#include <stdio.h>
+
+#define N 1000000
+
+int a[N];
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  // Without runs the loop fills ten blocks per thread, all written by a
+  // single compression thread.
+  #pragma omp parallel num_threads(4) shared(var)
+  {
+    var++;
+    #pragma omp for
+    for(int i = 0; i < N; i++)
+      a[i] = i;
+  }
+
+  int error = (var != 4);
+  return error;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-pool.c:18:8
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-pool.c:18:8
+// CHECK: --------------------------------------------------
+// BLOCKS: SWORD: {{[1-9][0-9]+}} blocks, {{[0-9]+}} items, codecs: lzo {{[0-9]+}}, formats: columnar {{[0-9]+}}.
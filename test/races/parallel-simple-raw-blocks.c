@@ -0,0 +1,28 @@
+// RUN: %libsword-compile && env SWORD_OPTIONS="traces_path=%t_sword_data block_format=raw" %t && %libsword-analyze 2>&1 | FileCheck %s
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=RAW %s
+// RUN: rm -rf %t_sword_report && env SWORD_OPTIONS="traces_path=%t_sword_data" %t && %libsword-analyze 2>&1 | FileCheck %s
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=COLUMNAR %s
+#include <omp.h>
+#include <stdio.h>
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  #pragma omp parallel num_threads(2) shared(var)
+  {
+    var++;
+  }
+
+  int error = (var != 2);
+  return error;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-raw-blocks.c:14:8
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-raw-blocks.c:14:8
+// CHECK: --------------------------------------------------
+// RAW: SWORD: {{[0-9]+}} blocks, {{[0-9]+}} items, codecs: {{.*}}, formats: raw {{[0-9]+}}.
+// COLUMNAR: SWORD: {{[0-9]+}} blocks, {{[0-9]+}} items, codecs: {{.*}}, formats: columnar {{[0-9]+}}.
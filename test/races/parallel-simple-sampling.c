@@ -0,0 +1,37 @@
+// RUN: %libsword-compile && env SWORD_OPTIONS="traces_path=%t_sword_data sampling=1" %t && %libsword-analyze 2>&1 | FileCheck %s
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=SAMPLED %s
+#include <omp.h>
+#include <stdio.h>
+
+#define N 100000
+
+int a[2][N];
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  #pragma omp parallel num_threads(2) shared(a, var)
+  {
+    // Hot site, sampled sparsely.
+    int t = omp_get_thread_num();
+    for(int i = 0; i < N; i++)
+      a[t][i] = i;
+    // Cold site, recorded.
+    var++;
+  }
+
+  int error = (var != 2);
+  return error;
+}
+
+// CHECK: SWORD: Parallel region {{[0-9]+}} was sampled, the analysis covered {{[0-9]+}} of {{[0-9]+}} accesses
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-sampling.c:21:8
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-sampling.c:21:8
+// CHECK: --------------------------------------------------
+
+// The interval records of the container keep the counters of the sampler.
+// SAMPLED: SWORD: {{[0-9]+}} interval records, {{[1-9][0-9]*}} accesses recorded, {{[1-9][0-9]*}} sampled out.
@@ -0,0 +1,37 @@
+// RUN: %clang-sword %static-analysis-flags %openmp_flags %sword_flags %flags -mllvm -sword-site-ids %s -o %t %libsword-libs && %libsword-run 2>&1 | FileCheck %s
+// RUN: %clang-sword %static-analysis-flags %openmp_flags %sword_flags %flags -mllvm -sword-site-ids %s -S -emit-llvm -o - | FileCheck --check-prefix=IR %s
+#include <omp.h>
+#include <stdio.h>
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  #pragma omp parallel num_threads(2) shared(var)
+  {
+    var++;
+  }
+
+  int error = (var != 2);
+  return error;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-site-ids.c:12:8
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-site-ids.c:12:8
+// CHECK: --------------------------------------------------
+
+// The store of var is the site (12, 8, size4 write) of the table of the
+// module, registered by its constructor. The access passes its site ID
+// instead of a pc.
+// IR: @__sword_site_base = internal {{.*}}global i32 0
+// IR: @__sword_sites = private {{.*}}constant [{{[0-9]+}} x %struct.SwordSite] [{{.*}}%struct.SwordSite { i32 12, i32 8, i8 33,
+// IR: @llvm.global_ctors = {{.*}}@sword.module_ctor
+// IR-LABEL: define internal void @.omp_outlined.(
+// IR-NOT: call void @__sword_write4(
+// IR: load i32, i32* @__sword_site_base
+// IR: call void @__sword_site_access(i8* {{.*}}, i32
+// IR-LABEL: define internal void @sword.module_ctor()
+// IR-NEXT: call void @__sword_register_sites({{.*}}@__sword_sites{{.*}}, i32* @__sword_site_base)
@@ -0,0 +1,36 @@
+// RUN: %libsword-compile && %libsword-sweep-run 2>&1 | FileCheck %s
+#include <omp.h>
+#include <stdio.h>
+
+#define N 100000
+
+int a[N];
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+  int sum = 0;
+
+  // The loop runs are disjoint, the critical section is not a race.
+  #pragma omp parallel num_threads(4) shared(var, sum)
+  {
+    var++;
+    #pragma omp for
+    for(int i = 0; i < N; i++)
+      a[i] = i;
+    #pragma omp critical
+    sum++;
+  }
+
+  int error = (sum != 4);
+  return error;
+}
+
+// CHECK-NOT: parallel-simple-sweep.c:22
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-sweep.c:17:8
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-sweep.c:17:8
+// CHECK: --------------------------------------------------
+// CHECK-NOT: parallel-simple-sweep.c:22
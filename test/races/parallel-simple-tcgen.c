@@ -0,0 +1,43 @@
+// RUN: %libsword-compile && env SWORD_OPTIONS="traces_path=%t_sword_data codec=none access_runs=0" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.none
+// RUN: FileCheck %s < %t.none
+// RUN: rm -rf %t_sword_report && env SWORD_OPTIONS="traces_path=%t_sword_data codec=tcgen access_runs=0" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.tcgen
+// RUN: diff %t.none %t.tcgen
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=TCGEN %s
+// RUN: rm -rf %t_sword_report && env SWORD_OPTIONS="traces_path=%t_sword_data codec=tcgen access_runs=1" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.tcgen-runs
+// RUN: FileCheck %s < %t.tcgen-runs
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=TCGEN %s
+#include <omp.h>
+#include <stdio.h>
+
+#define N 100000
+
+int a[N];
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  // Several blocks per thread without runs, tcgen must decode the blocks it
+  // predicted.
+  #pragma omp parallel num_threads(4) shared(var)
+  {
+    var++;
+    #pragma omp for
+    for(int i = 0; i < N; i++)
+      a[i] = i;
+  }
+
+  int error = (var != 4);
+  return error;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-tcgen.c:24:8
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-tcgen.c:24:8
+// CHECK: --------------------------------------------------
+
+// tcgen takes raw blocks. It cannot compress the smallest ones, which are
+// written plain.
+// TCGEN: SWORD: {{[0-9]+}} blocks, {{[0-9]+}} items, codecs: {{(none [0-9]+ )?}}tcgen {{[0-9]+}}, formats: raw {{[0-9]+}}.
@@ -0,0 +1,41 @@
+// RUN: %libsword-compile && env SWORD_OPTIONS="traces_path=%t_sword_data codec=none access_runs=0" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.none
+// RUN: FileCheck %s < %t.none
+// RUN: rm -rf %t_sword_report && env SWORD_OPTIONS="traces_path=%t_sword_data codec=zstd access_runs=0" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.zstd
+// RUN: diff %t.none %t.zstd
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=ZSTD %s
+// RUN: rm -rf %t_sword_report && env SWORD_OPTIONS="traces_path=%t_sword_data codec=zstd codec_level=19 access_runs=0" %t && %libsword-analyze 2>&1 | grep -v "^SWORD:" > %t.zstd19
+// RUN: diff %t.none %t.zstd19
+// RUN: %sword-race-analysis --executable %t --traces-path %t_sword_data --report-path %t_sword_report --stats | FileCheck --check-prefix=ZSTD %s
+// REQUIRES: zstd
+#include <omp.h>
+#include <stdio.h>
+
+#define N 100000
+
+int a[N];
+
+int main(int argc, char* argv[])
+{
+  int var = 0;
+
+  // Several blocks per thread without runs, the report must not depend on
+  // the codec.
+  #pragma omp parallel num_threads(4) shared(var)
+  {
+    var++;
+    #pragma omp for
+    for(int i = 0; i < N; i++)
+      a[i] = i;
+  }
+
+  int error = (var != 4);
+  return error;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-zstd.c:25:8
+// CHECK:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-simple-zstd.c:25:8
+// CHECK: --------------------------------------------------
+// ZSTD: SWORD: {{[0-9]+}} blocks, {{[0-9]+}} items, codecs: zstd {{[0-9]+}}, formats:
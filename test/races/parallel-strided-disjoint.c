@@ -0,0 +1,42 @@
+// RUN: %libsword-compile-and-run-race 2>&1 | FileCheck %s
+#include <omp.h>
+#include <stdio.h>
+
+#define N 1000
+
+int a[2 * N];
+int b[6 * N];
+char c[16 * N];
+
+int main(int argc, char* argv[])
+{
+  // The strided intervals of the threads overlap, their accesses do not.
+  #pragma omp parallel num_threads(2)
+  {
+    int t = omp_get_thread_num();
+    // Interleaved, 8 bytes apart and 4 wide.
+    for(int i = 0; i < N; i++)
+      a[2 * i + t] = i;
+    // Elements 4i + 1 and 6j, the gcd of the strides does not divide 1.
+    if(t == 0) {
+      for(int i = 0; i < N; i++)
+        b[4 * i + 1] = i;
+    } else {
+      for(int i = 0; i < N; i++)
+        b[6 * i] = i;
+    }
+    // Bytes 0 to 7 and 8 to 11 of every 16.
+    if(t == 0) {
+      for(int i = 0; i < N; i++)
+        *(double *) (c + 16 * i) = i;
+    } else {
+      for(int i = 0; i < N; i++)
+        *(int *) (c + 16 * i + 8) = i;
+    }
+  }
+
+  return 0;
+}
+
+// CHECK-NOT: data race
+// CHECK: SWORD did not find any race
@@ -0,0 +1,41 @@
+// RUN: %libsword-compile-and-run-race 2>&1 | FileCheck %s
+#include <omp.h>
+#include <stdio.h>
+
+#define N 1000
+
+int a[3 * N];
+char c[16 * N];
+
+int main(int argc, char* argv[])
+{
+  // Strided accesses of the threads that meet every few strides only.
+  #pragma omp parallel num_threads(2)
+  {
+    int t = omp_get_thread_num();
+    // Elements 2i and 3j meet at the multiples of 6.
+    if(t == 0) {
+      for(int i = 0; i < N; i++)
+        a[2 * i] = i;
+    } else {
+      for(int i = 0; i < N; i++)
+        a[3 * i] = i;
+    }
+    // Bytes 0 to 7 and 4 to 7 of every 16.
+    if(t == 0) {
+      for(int i = 0; i < N; i++)
+        *(double *) (c + 16 * i) = i;
+    } else {
+      for(int i = 0; i < N; i++)
+        *(int *) (c + 16 * i + 4) = i;
+    }
+  }
+
+  return 0;
+}
+
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK-DAG: Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-strided-overlap.c:19:18
+// CHECK-DAG: Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-strided-overlap.c:22:18
+// CHECK-DAG: Write of size 8 in .omp_outlined.{{.*}} at {{.*}}parallel-strided-overlap.c:27:34
+// CHECK-DAG: Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-strided-overlap.c:30:35
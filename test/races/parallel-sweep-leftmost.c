@@ -0,0 +1,41 @@
+// RUN: %libsword-compile && %libsword-sweep-run 2>&1 | FileCheck %s
+#include <omp.h>
+#include <stdio.h>
+
+#define N 1000
+
+int a[N];
+int sink;
+
+int main(int argc, char* argv[])
+{
+  // The run of thread 0 is the leftmost node of its tree and the reads
+  // after it are above it, the tree engine only walks the path of
+  // a[N - 1] and misses the race. The sweep finds it.
+  #pragma omp parallel num_threads(2)
+  {
+    if(omp_get_thread_num() == 0) {
+      for(int i = 0; i < N; i++)
+        a[i] = i;
+      sink += a[1];
+      sink += a[2];
+      sink += a[3];
+      sink += a[4];
+      sink += a[5];
+      sink += a[6];
+      sink += a[7];
+      sink += a[8];
+    } else {
+      a[N - 1] = 0;
+    }
+  }
+
+  return 0;
+}
+
+// CHECK: --------------------------------------------------
+// CHECK: WARNING: SWORD: data race (program={{.*}})
+// CHECK:   Two different threads made the following accesses:
+// CHECK-DAG:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-sweep-leftmost.c:19:14
+// CHECK-DAG:     Write of size 4 in .omp_outlined.{{.*}} at {{.*}}parallel-sweep-leftmost.c:29:16
+// CHECK: --------------------------------------------------
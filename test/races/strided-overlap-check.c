@@ -0,0 +1,7 @@
+// RUN: %sword-overlap-check | FileCheck %s
+// The closed-form overlap test of strided intervals agrees with a search
+// access by access on random pairs, and with GLPK in GLPK builds.
+
+// CHECK-NOT: Overlap mismatch
+// CHECK: SWORD: 200000 pairs of strided intervals, {{[0-9]+}} overlap, 0 mismatches.
+// CHECK-NOT: Overlap mismatch
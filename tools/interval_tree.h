@@ -2,78 +2,269 @@
 #define _LINUX_INTERVAL_TREE_H
 
 #include <cstdint>
-#include <glpk.h>
 #include <stdio.h>
+#include <stdlib.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <mutex>
+#include <new>
 #include <set>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #define PRINT 0
 
-#ifdef PRINT
-#include <atomic>
-static std::atomic<int> global_key(0);
-#endif // PRINT
-
 extern "C" {
 #include "rbtree.h"
 
 static const char * TypeValue[] = { "R", "W", "AR", "AW" };
 
-#define END(node) ((node)->start + ((node)->diff * ((node)->count - 1)))
+#define END(node) ((node)->start + ((node)->diff * ((node)->count() - 1)))
 
+// One cache line: the number of accesses is not stored, a node spans
+// [start, last] with a stride of diff, and the lockset is an id in the
+// lockset table of the analysis. The id takes the bits left next to
+// size_type, which limits the trees of a barrier interval to MAX_LOCKSETS
+// locksets; past that the interval is swept (sword-sweep-analysis.h).
 struct interval_tree_node {
-#ifdef PRINT
-  int key;
-#endif
   struct rb_node rb;
   size_t start;
   size_t last;
   size_t __subtree_last;
-  unsigned count;
-  uint8_t size_type; // size in first 4 bits, type in last 4 bits
-  unsigned diff;
   size_t pc;
-  std::set<size_t> mutex;
+  unsigned diff;
+  uint32_t size_type : 8; // size in first 4 bits, type in last 4 bits
+  uint32_t mutex : 24;    // lockset id, 0 for no lock, below MAX_LOCKSETS
 
-  interval_tree_node(size_t s, size_t l, uint8_t st, size_t p, const std::set<size_t> mtx) {
-#ifdef PRINT
-    key = ++global_key;
-#endif // PRINT
+  interval_tree_node(size_t s, size_t l, uint8_t st, size_t p, uint32_t mtx) {
     start = s;
     last = l;
-    count = 1;
     diff = 0;
     size_type = st;
     pc = p;
-    mutex.insert(mtx.begin(), mtx.end());
+    mutex = mtx;
+  }
+
+  size_t count() const {
+    return diff ? (last - start) / diff + 1 : 1;
   }
 
+  bool single() const {
+    return diff == 0 || last - start < diff;
+  }
+
+#ifdef PRINT
+  // Node id in the dot output.
+  size_t key() const {
+    return (size_t) this;
+  }
+#endif // PRINT
+
   void print() {
     std::cout << "Start: " << start << std::endl
               << " Last: " << last << std::endl
               << " Type: " << TypeValue[(size_type & 0x0F)] << std::endl
               << " Size: " << (1 << (size_type >> 4)) << std::endl
-              << "Count: " << count << std::endl
+              << "Count: " << count() << std::endl
               << " Diff: " << diff << std::endl
               << "   PC: " << pc << std::endl;
   }
 };
 
+#define ARENA_FIRST_CHUNK	256   // nodes
+#define ARENA_MAX_CHUNK		65536 // nodes
+#define MAX_LOCKSETS		(1 << 24)
+
+// Totals of the arenas released so far, for sword-race-analysis --stats.
+extern std::atomic<uint64_t> interval_tree_arena_nodes;
+extern std::atomic<uint64_t> interval_tree_arena_bytes;
+
+// Nodes of a tree. The nodes are carved out of cache aligned
+// chunks, which double up to ARENA_MAX_CHUNK nodes; the nodes erased from
+// the tree are recycled, and clear() drops the whole tree at once.
+class interval_tree_arena {
+ private:
+  std::vector<interval_tree_node *> chunks;
+  size_t chunk_size;
+  size_t used; // nodes in the last chunk
+  interval_tree_node *recycled; // linked through rb.rb_right
+
+ public:
+  size_t nodes;
+  size_t bytes;
+
+  interval_tree_arena() : chunk_size(0), used(0), recycled(NULL), nodes(0), bytes(0) {}
+
+  ~interval_tree_arena() {
+    clear();
+  }
+
+  interval_tree_node *alloc(const interval_tree_node &node) {
+    void *p = recycled;
+    if(recycled) {
+      recycled = (interval_tree_node *) recycled->rb.rb_right;
+    } else {
+      if(chunks.empty() || used == chunk_size) {
+        chunk_size = chunks.empty() ? ARENA_FIRST_CHUNK : std::min<size_t>(2 * chunk_size, ARENA_MAX_CHUNK);
+        void *chunk;
+        if(posix_memalign(&chunk, 64, chunk_size * sizeof(interval_tree_node)) != 0)
+          throw std::bad_alloc();
+        chunks.push_back((interval_tree_node *) chunk);
+        bytes += chunk_size * sizeof(interval_tree_node);
+        used = 0;
+      }
+      p = chunks.back() + used++;
+      nodes++;
+    }
+    return new (p) interval_tree_node(node);
+  }
+
+  void recycle(interval_tree_node *node) {
+    node->rb.rb_right = (struct rb_node *) recycled;
+    recycled = node;
+  }
+
+  // Releases all the nodes.
+  void clear() {
+    for(interval_tree_node *chunk : chunks)
+      free(chunk);
+    interval_tree_arena_nodes += nodes;
+    interval_tree_arena_bytes += bytes;
+    chunks.clear();
+    chunk_size = used = nodes = bytes = 0;
+    recycled = NULL;
+  }
+};
+
+struct interval_tree_lockset_hash {
+  size_t operator()(const std::set<size_t> &lockset) const {
+    size_t hash = lockset.size();
+    for(size_t lock : lockset)
+      hash = hash * 31 + lock;
+    return hash;
+  }
+};
+
+// Locksets of the trees of a barrier interval, hash-consed: equal locksets
+// have equal ids, 0 is the empty lockset. The trees of the threads share the
+// table and may be built on several threads. Past limit the ids are no
+// longer exact: the table overflows and the caller checks the barrier
+// interval with a table of wider ids.
+class interval_tree_locksets {
+ private:
+  std::mutex mtx;
+  std::unordered_map<std::set<size_t>, uint32_t, interval_tree_lockset_hash> ids;
+  std::vector<const std::set<size_t> *> locksets; // by id, from 1
+  uint32_t limit;
+  bool overflow;
+
+ public:
+  interval_tree_locksets(uint32_t max = MAX_LOCKSETS) : limit(max), overflow(false) {}
+
+  uint32_t intern(const std::set<size_t> &lockset) {
+    if(lockset.empty())
+      return 0;
+    std::unique_lock<std::mutex> lock(mtx);
+    std::unordered_map<std::set<size_t>, uint32_t, interval_tree_lockset_hash>::iterator it = ids.find(lockset);
+    if(it != ids.end())
+      return it->second;
+    if(locksets.size() + 1 >= limit) {
+      overflow = true;
+      return 0;
+    }
+    it = ids.insert(std::make_pair(lockset, (uint32_t) locksets.size() + 1)).first;
+    locksets.push_back(&it->first);
+    return it->second;
+  }
+
+  // True if the locksets share a lock.
+  bool intersect(uint32_t a, uint32_t b) {
+    if(!a || !b)
+      return false;
+    if(a == b)
+      return true;
+    std::unique_lock<std::mutex> lock(mtx);
+    const std::set<size_t> &s1 = *locksets[a - 1];
+    const std::set<size_t> &s2 = *locksets[b - 1];
+    std::set<size_t>::const_iterator i = s1.begin(), j = s2.begin();
+    while(i != s1.end() && j != s2.end()) {
+      if(*i < *j)
+        ++i;
+      else if(*j < *i)
+        ++j;
+      else
+        return true;
+    }
+    return false;
+  }
+
+  size_t size() {
+    std::unique_lock<std::mutex> lock(mtx);
+    return locksets.size();
+  }
+
+  bool overflowed() {
+    std::unique_lock<std::mutex> lock(mtx);
+    return overflow;
+  }
+};
+
+// Memoized intersect() of a table, for one thread.
+class interval_tree_lockset_cache {
+ private:
+  interval_tree_locksets *locksets;
+  std::unordered_map<uint64_t, bool> intersections; // by (min id, max id)
+
+ public:
+  interval_tree_lockset_cache(interval_tree_locksets *l) : locksets(l) {}
+
+  bool intersect(uint32_t a, uint32_t b) {
+    if(!a || !b)
+      return false;
+    if(a == b)
+      return true;
+    uint64_t key = a < b ? ((uint64_t) a << 32) | b : ((uint64_t) b << 32) | a;
+    std::unordered_map<uint64_t, bool>::iterator it = intersections.find(key);
+    if(it != intersections.end())
+      return it->second;
+    return intersections[key] = locksets->intersect(a, b);
+  }
+};
+
+// A tree owns its nodes, the trees of a barrier interval share the locksets.
+struct interval_tree_root : rb_root {
+  interval_tree_arena arena;
+  interval_tree_locksets *locksets;
+
+  interval_tree_root(interval_tree_locksets *l) : locksets(l) {
+    rb_node = NULL;
+  }
+};
+
+extern bool interval_overlap_check;
+extern std::atomic<uint64_t> interval_overlap_mismatches;
+
 extern void
 interval_tree_insert(struct interval_tree_node *node, struct rb_root *root);
 
 extern void
-interval_tree_insert_data(struct interval_tree_node node, struct rb_root *root, int t);
+interval_tree_insert_data(struct interval_tree_node node, struct interval_tree_root *root, int t);
 
 extern void
-interval_tree_merge(struct rb_root *tree1, struct rb_root *tree2);
+interval_tree_merge(struct interval_tree_root *tree1, struct interval_tree_root *tree2);
+
+// True if node1 of thread t1 and node2 of thread t2 access a common address
+// and one of them writes, the locksets aside.
+extern bool
+interval_tree_conflict(unsigned t1, struct interval_tree_node *node1,
+                       unsigned t2, struct interval_tree_node *node2);
 
 extern void
-interval_tree_overlap(std::mutex &mtx, unsigned t1, struct rb_root *tree1,
-                      unsigned t2, struct rb_root *tree2,
+interval_tree_overlap(std::mutex &mtx, unsigned t1, struct interval_tree_root *tree1,
+                      unsigned t2, struct interval_tree_root *tree2,
                       std::vector<std::pair<struct interval_tree_node, struct interval_tree_node>> &races);
 
 extern void
@@ -88,9 +279,9 @@ interval_tree_iter_next(struct interval_tree_node *node,
 			size_t start, size_t last);
 
 #ifdef PRINT
-extern void interval_tree_print(struct rb_root *root);
+extern void interval_tree_print(struct interval_tree_root *root);
 extern void print_dot_aux(struct interval_tree_node *node, std::stringstream &ss);
-extern void print_dot_null(int key, int nullcount, std::stringstream &ss);
+extern void print_dot_null(size_t key, int nullcount, std::stringstream &ss);
 #endif // PRINT
 }
 
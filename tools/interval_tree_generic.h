@@ -22,7 +22,10 @@
 #include <stdbool.h>
 
 #include <algorithm>
+#include <atomic>
+#ifdef GLPK
 #include <glpk.h>
+#endif
 #include <mutex>
 #include <set>
 #include <sstream>
@@ -31,6 +34,13 @@ extern "C" {
 #include "rbtree_augmented.h"
 
 std::mutex mipmtx;
+// sword-race-analysis --check-overlaps, GLPK builds only: every overlap of
+// strided intervals is solved with GLPK as well, the mismatches are printed.
+bool interval_overlap_check = false;
+std::atomic<uint64_t> interval_overlap_mismatches(0);
+// Nodes and bytes of the arenas freed so far, for sword-race-analysis --stats.
+std::atomic<uint64_t> interval_tree_arena_nodes(0);
+std::atomic<uint64_t> interval_tree_arena_bytes(0);
 
 /*
  * Template for implementing interval trees
@@ -48,14 +58,6 @@ std::mutex mipmtx;
  * (interval_tree.h) would work for you...
  */
 
- static inline bool overlap(const std::set<size_t>& s1, const std::set<size_t>& s2) {
-   for(const auto& i : s1) {
-     if(std::binary_search(s2.begin(), s2.end(), i))
-       return true;
-   }
-   return false;
- }
-
 enum AccessType {
   unsafe_read = 0,
   unsafe_write,
@@ -101,7 +103,7 @@ RB_DECLARE_CALLBACKS(static, ITPREFIX ## _augment, ITSTRUCT, ITRB,	      \
 									      \
 /* Insert / remove interval nodes from the tree */			      \
 									      \
-ITSTATIC void ITPREFIX ## _insert_data(ITSTRUCT node, struct rb_root *root, int t) \
+ITSTATIC void ITPREFIX ## _insert_data(ITSTRUCT node, struct interval_tree_root *root, int t) \
 {									      \
         struct rb_node **link = &root->rb_node, *rb_parent = NULL;            \
 	ITTYPE start = node.start, last = node.last, end = 0;                 \
@@ -111,13 +113,14 @@ ITSTATIC void ITPREFIX ## _insert_data(ITSTRUCT node, struct rb_root *root, int
 		rb_parent = *link;					      \
 		parent = rb_entry(rb_parent, ITSTRUCT, ITRB);		      \
                                                                               \
-                if((node.size_type == parent->size_type) &&                   \
+                /* Runs recorded by the runtime are inserted as they are */  \
+                if(node.single() &&                                           \
+                   (node.size_type == parent->size_type) &&                   \
                    (node.pc == parent->pc) && (node.mutex == parent->mutex)) {\
                   if(parent->diff != 0) {                                     \
                     end = END(parent);                                        \
                     if(node.start == (end + parent->diff)) {                  \
-                      parent->count++;                                        \
-                      parent->last = END(parent);                             \
+                      parent->last = END(parent) + parent->diff;              \
                       return;                                                 \
                     }                                                         \
                     if((node.start >= parent->start) &&                       \
@@ -125,7 +128,6 @@ ITSTATIC void ITPREFIX ## _insert_data(ITSTRUCT node, struct rb_root *root, int
                       return;                                                 \
                     if(node.start == (parent->start - parent->diff)) {        \
                       parent->start = node.start;                             \
-                      parent->count++;                                        \
                       return;                                                 \
                     }                                                         \
                   } else {                                                    \
@@ -134,8 +136,7 @@ ITSTATIC void ITPREFIX ## _insert_data(ITSTRUCT node, struct rb_root *root, int
                       end = END(parent);                                      \
                       parent->diff = diff;                                    \
                       if(node.start == (end + diff)) {                        \
-                        parent->count++;                                      \
-                        parent->last = END(parent);                           \
+                        parent->last = END(parent) + diff;                    \
                         return;                                               \
                       }                                                       \
                       if((node.start >= parent->start) &&                     \
@@ -143,7 +144,6 @@ ITSTATIC void ITPREFIX ## _insert_data(ITSTRUCT node, struct rb_root *root, int
                         return;                                               \
                       if(node.start == (parent->start - parent->diff)) {      \
                         parent->start = node.start;                           \
-                        parent->count++;                                      \
                         return;                                               \
                       }                                                       \
                     } else {                                                  \
@@ -160,8 +160,7 @@ ITSTATIC void ITPREFIX ## _insert_data(ITSTRUCT node, struct rb_root *root, int
                   link = &parent->ITRB.rb_right;                              \
 	}								      \
 									      \
-        interval_tree_node *new_node = new interval_tree_node(                \
-                 node.start, node.last, node.size_type, node.pc, node.mutex); \
+        interval_tree_node *new_node = root->arena.alloc(node);               \
 	new_node->ITSUBTREE = last;					      \
 	rb_link_node(&new_node->ITRB, rb_parent, link);			      \
 	rb_insert_augmented(&new_node->ITRB, root, &ITPREFIX ## _augment);    \
@@ -242,12 +241,13 @@ ITPREFIX ## _subtree_search(ITSTRUCT *node, ITTYPE start, ITTYPE last)	      \
 }									      \
 									      \
 ITSTATIC void ITPREFIX ## _overlap(std::mutex &mtx,                           \
-  unsigned t1, struct rb_root *tree1,                                         \
-  unsigned t2, struct rb_root *tree2,                                         \
+  unsigned t1, struct interval_tree_root *tree1,                              \
+  unsigned t2, struct interval_tree_root *tree2,                              \
   std::vector<std::pair<ITSTRUCT,ITSTRUCT>> &races) {                          \
   struct rb_node **link, *rb_parent;                                          \
   ITSTRUCT *parent;                                                           \
   struct rb_node *node2;                                                      \
+  interval_tree_lockset_cache locksets(tree1->locksets);                      \
                                                                               \
   for (node2 = rb_first(tree2); node2; node2 = rb_next(node2)) {              \
     ITSTRUCT *node = rb_entry(node2, ITSTRUCT, ITRB);                         \
@@ -258,26 +258,11 @@ ITSTATIC void ITPREFIX ## _overlap(std::mutex &mtx,                           \
       rb_parent = *link;                                                      \
       parent = rb_entry(rb_parent, ITSTRUCT, ITRB);                           \
                                                                               \
-      bool overlapping = false;                                               \
-      if((node->mutex.size() != 0) && (parent->mutex.size() != 0))            \
-        overlapping = overlap(node->mutex, parent->mutex);                    \
-      if(RACE(node,parent) && !overlapping) {                                 \
-        if((start <= parent->last) &&                                         \
-           (parent->start <= last)) {                                         \
-          bool has_overlapping = (parent->count == 1) && (node->count == 1);  \
-          if(!has_overlapping) {                                              \
-            if(parent->start >= start) {                                      \
-              has_overlapping = solve_mip(t1, parent, t2, node);              \
-            } else {                                                          \
-              has_overlapping = solve_mip(t2, node, t1, parent);              \
-            }                                                                 \
-          }                                                                   \
-          if(has_overlapping) {                                               \
-            mtx.lock();                                                       \
-            races.emplace_back(*node, *parent);                               \
-            mtx.unlock();                                                     \
-          }                                                                   \
-        }                                                                     \
+      if(!locksets.intersect(node->mutex, parent->mutex) &&                   \
+         interval_tree_conflict(t1, parent, t2, node)) {                      \
+        mtx.lock();                                                           \
+        races.emplace_back(*node, *parent);                                   \
+        mtx.unlock();                                                         \
       }                                                                       \
                                                                               \
       if (parent->ITSUBTREE < last)                                           \
@@ -290,7 +275,8 @@ ITSTATIC void ITPREFIX ## _overlap(std::mutex &mtx,                           \
   }                                                                           \
 }			      				                      \
 			      				                      \
-ITSTATIC void ITPREFIX ## _merge(struct rb_root *tree1, struct rb_root *tree2)\
+ITSTATIC void ITPREFIX ## _merge(struct interval_tree_root *tree1,            \
+                                 struct interval_tree_root *tree2)            \
 {									      \
   struct rb_node **link, *rb_parent;                                          \
   ITSTRUCT *parent;                                                           \
@@ -309,31 +295,19 @@ ITSTATIC void ITPREFIX ## _merge(struct rb_root *tree1, struct rb_root *tree2)\
       if((node->size_type == parent->size_type) &&                            \
          (node->pc == parent->pc) && (node->mutex == parent->mutex) &&        \
          (node->diff == parent->diff)) {                                      \
-        if(!((node->count == parent->count) && parent->count == 1)) {         \
+        if(!(node->single() && parent->single())) {                           \
           if(parent->start - last == parent->diff) {                          \
             merged = true;                                                    \
             parent->start = start;                                            \
-            if(parent->diff != 0)                                             \
-              parent->count = ((parent->last - parent->start) / parent->diff) + 1; \
-            else                                                              \
-              parent->count = 1;                                              \
             break;                                                            \
           } else if(start - parent->last == parent->diff) {                   \
             merged = true;                                                    \
             parent->last = last;                                              \
-            if(parent->diff != 0)                                             \
-              parent->count = ((parent->last - parent->start) / parent->diff) + 1; \
-            else                                                              \
-              parent->count = 1;                                              \
             break;                                                            \
           } else if((start <= parent->last) && (parent->start <= last)) {     \
             merged = true;                                                    \
             parent->start = parent->start < start ? parent->start : start;    \
             parent->last = parent->last < last ? last : parent->last;         \
-            if(parent->diff != 0)                                             \
-              parent->count = ((parent->last - parent->start) / parent->diff) + 1; \
-            else                                                              \
-              parent->count = 1;                                              \
             break;                                                            \
           }                                                                   \
         } else if(parent->start == start) {                                   \
@@ -351,15 +325,14 @@ ITSTATIC void ITPREFIX ## _merge(struct rb_root *tree1, struct rb_root *tree2)\
     }                                                                         \
                                                                               \
     if(!merged) {                                                             \
-      interval_tree_node *new_node = new interval_tree_node(                  \
-        node->start, node->last, node->size_type, node->pc, node->mutex);     \
+      interval_tree_node *new_node = tree1->arena.alloc(*node);               \
       new_node->ITSUBTREE = last;                                             \
       rb_link_node(&new_node->ITRB, rb_parent, link);                         \
       rb_insert_augmented(&new_node->ITRB, tree1, &ITPREFIX ## _augment);     \
     }                                                                         \
     node2 = rb_prev(node2);                                                   \
     rb_erase(&node->ITRB, tree2);                                             \
-    free(node);                                                               \
+    tree2->arena.recycle(node);                                               \
   }                                                                           \
 }			      				                      \
                                                                               \
@@ -415,7 +388,7 @@ ITPREFIX ## _iter_next(ITSTRUCT *node, ITTYPE start, ITTYPE last)	      \
 }
 
 #ifdef PRINT
-void print_dot_null(int key, int nullcount, std::stringstream &ss) {
+void print_dot_null(size_t key, int nullcount, std::stringstream &ss) {
     ss << "    null" << nullcount << " [shape=point];" << std::endl;
     ss << "    " << key <<"-> null" << nullcount << ";" << std::endl;
   }
@@ -426,26 +399,26 @@ void print_dot_aux(struct interval_tree_node *node, std::stringstream &ss)
 
     if (node->rb.rb_left) {
         interval_tree_node *left = rb_entry(node->rb.rb_left, struct interval_tree_node, rb);
-        ss << "    " << node->key << " -> " << left->key << ";" << std::endl;
-        ss << node->key << " [label=\"[" << node->start << "," << node->last << "]," << node->count << "\n" << TypeValue[(node->size_type & 0x0F)] << "," << (1 << (node->size_type >> 4)) << "," << node->pc << "\"]" << std::endl;
-        ss << left->key << " [label=\"[" << left->start << "," << left->last << "]," << left->count << "\n" << TypeValue[(left->size_type & 0x0F)] << "," << (1 << (left->size_type >> 4)) << "," << left->pc << "\"]" << std::endl;
+        ss << "    " << node->key() << " -> " << left->key() << ";" << std::endl;
+        ss << node->key() << " [label=\"[" << node->start << "," << node->last << "]," << node->count() << "\n" << TypeValue[(node->size_type & 0x0F)] << "," << (1 << (node->size_type >> 4)) << "," << node->pc << "\"]" << std::endl;
+        ss << left->key() << " [label=\"[" << left->start << "," << left->last << "]," << left->count() << "\n" << TypeValue[(left->size_type & 0x0F)] << "," << (1 << (left->size_type >> 4)) << "," << left->pc << "\"]" << std::endl;
         print_dot_aux(left, ss);
       }
     else
-      print_dot_null(node->key, nullcount++, ss);
+      print_dot_null(node->key(), nullcount++, ss);
 
     if (node->rb.rb_right) {
         interval_tree_node *right = rb_entry(node->rb.rb_right, struct interval_tree_node, rb);
-        ss << "    " << node->key << " -> " << right->key << ";" << std::endl;
-        ss << node->key << " [label=\"[" << node->start << "," << node->last << "]," << node->count << "\n" << TypeValue[(node->size_type & 0x0F)] << "," << (1 << (node->size_type >> 4))  << "," << node->pc << "\"]" << std::endl;
-        ss << right->key << " [label=\"[" << right->start << "," << right->last << "]," << right->count << "\n" << TypeValue[(right->size_type & 0x0F)] << "," << (1 << (right->size_type >> 4)) << "," << right->pc << "\"]" << std::endl;
+        ss << "    " << node->key() << " -> " << right->key() << ";" << std::endl;
+        ss << node->key() << " [label=\"[" << node->start << "," << node->last << "]," << node->count() << "\n" << TypeValue[(node->size_type & 0x0F)] << "," << (1 << (node->size_type >> 4))  << "," << node->pc << "\"]" << std::endl;
+        ss << right->key() << " [label=\"[" << right->start << "," << right->last << "]," << right->count() << "\n" << TypeValue[(right->size_type & 0x0F)] << "," << (1 << (right->size_type >> 4)) << "," << right->pc << "\"]" << std::endl;
         print_dot_aux(right, ss);
       }
     else
-      print_dot_null(node->key, nullcount++, ss);
+      print_dot_null(node->key(), nullcount++, ss);
   }
 
-void interval_tree_print(struct rb_root *root) {
+void interval_tree_print(struct interval_tree_root *root) {
   std::stringstream ss;
   ss << "digraph BST {\n" << std::endl;
   ss << "    node [fontname=\"Arial\"];\n" << std::endl;
@@ -455,7 +428,7 @@ void interval_tree_print(struct rb_root *root) {
   if (!root->rb_node) {
     ss << "\n" << std::endl;
   } else if (!parent->rb.rb_right && !parent->rb.rb_left)
-    ss << "    " << parent->key << ";" << std::endl;
+    ss << "    " << parent->key() << ";" << std::endl;
   else
     print_dot_aux(parent, ss);
 
@@ -464,6 +437,82 @@ void interval_tree_print(struct rb_root *root) {
 }
 #endif // PRINT
 
+// b > 0, with the 64-bit division when a fits.
+static inline __int128 floor_div(__int128 a, __int128 b) {
+  if(a == (int64_t) a && b == (int64_t) b) {
+    int64_t q = (int64_t) a / (int64_t) b;
+    return q - ((int64_t) a % (int64_t) b < 0);
+  }
+  return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+static inline __int128 ceil_div(__int128 a, __int128 b) {
+  return -floor_div(-a, b);
+}
+
+// Returns gcd(a, b) and x, y with a * x + b * y == gcd(a, b).
+static inline int64_t extended_gcd(int64_t a, int64_t b, int64_t &x, int64_t &y) {
+  int64_t x0 = 1, y0 = 0, x1 = 0, y1 = 1;
+  while(b != 0) {
+    int64_t q = a / b, t;
+    t = a - q * b; a = b; b = t;
+    t = x0 - q * x1; x0 = x1; x1 = t;
+    t = y0 - q * y1; y0 = y1; y1 = t;
+  }
+  x = x0;
+  y = y0;
+  return a;
+}
+
+// Whether [lo1, hi1] and [lo2, hi2] share an integer.
+static inline bool ranges_meet(__int128 lo1, __int128 hi1, __int128 lo2, __int128 hi2) {
+  return std::max(lo1, lo2) <= std::min(hi1, hi2);
+}
+
+// Closed form of solve_mip: whether an access of node1 and an access of
+// node2 share a byte, i.e. whether
+//   start1 + diff1 * x1 + size1 == start2 + diff2 * x2 + size2
+// for some x in [0, count - 1] and size in [0, width - 1]. That is
+// diff1 * x1 - diff2 * x2 == k for k in [lo, hi], at most width1 + width2 - 1
+// values; only the multiples of g = gcd(diff1, diff2) have solutions, which
+// are a particular one (extended Euclid) plus t * (diff2 / g, diff1 / g),
+// and some t must keep both x within their bounds.
+static inline bool progressions_overlap(const struct interval_tree_node *node1,
+                                        const struct interval_tree_node *node2) {
+  // A single access or a zero stride is one element.
+  int64_t d1 = node1->single() ? 0 : node1->diff;
+  int64_t d2 = node2->single() ? 0 : node2->diff;
+  __int128 c1 = d1 ? node1->count() - 1 : 0;
+  __int128 c2 = d2 ? node2->count() - 1 : 0;
+  __int128 base = (__int128) node2->start - (__int128) node1->start;
+  __int128 lo = base - ((1 << (node1->size_type >> 4)) - 1);
+  __int128 hi = base + ((1 << (node2->size_type >> 4)) - 1);
+
+  if(d1 == 0 && d2 == 0)
+    return lo <= 0 && 0 <= hi;
+  if(d2 == 0)
+    return ranges_meet(0, c1, ceil_div(lo, d1), floor_div(hi, d1));
+  if(d1 == 0)
+    return ranges_meet(0, c2, ceil_div(-hi, d2), floor_div(-lo, d2));
+
+  int64_t p, q;
+  int64_t g = extended_gcd(d1, d2, p, q);
+  int64_t a = d1 / g;
+  int64_t b = d2 / g;
+  // a * p == 1 modulo b
+  uint64_t pb = ((p % b) + b) % b;
+  for(__int128 k = ceil_div(lo, g) * g; k <= hi; k += g) {
+    __int128 m = floor_div(k, g);
+    __int128 x1 = pb * (uint64_t) (m - floor_div(m, b) * b) % b;
+    __int128 x2 = floor_div((__int128) d1 * x1 - k, d2);
+    // x1 + b * t in [0, c1] and x2 + a * t in [0, c2]
+    if(ranges_meet(ceil_div(-x1, b), floor_div(c1 - x1, b), ceil_div(-x2, a), floor_div(c2 - x2, a)))
+      return true;
+  }
+  return false;
+}
+
+#ifdef GLPK
 /*
 model = Model("IntervalsOvelap")
 
@@ -501,11 +550,11 @@ bool solve_mip(unsigned t1, struct interval_tree_node *node1,
   glp_set_row_bnds(mip, 1, GLP_FX, -1 * diff, -1 * diff);
   glp_add_cols(mip, 4);
   glp_set_col_name(mip, 1, "x1");
-  glp_set_col_bnds(mip, 1, GLP_DB, 0.0, node1->count);
+  glp_set_col_bnds(mip, 1, GLP_DB, 0.0, node1->count() - 1);
   glp_set_obj_coef(mip, 1, node1->diff);
   glp_set_col_kind(mip, 1, GLP_IV);
   glp_set_col_name(mip, 2, "x2");
-  glp_set_col_bnds(mip, 2, GLP_DB, 0.0, node2->count);
+  glp_set_col_bnds(mip, 2, GLP_DB, 0.0, node2->count() - 1);
   glp_set_obj_coef(mip, 2, node2->diff);
   glp_set_col_kind(mip, 2, GLP_IV);
   glp_set_col_name(mip, 3, "size1");
@@ -546,5 +595,34 @@ bool solve_mip(unsigned t1, struct interval_tree_node *node1,
 
   return res;
 }
+#endif // GLPK
+
+bool solve_overlap(unsigned t1, struct interval_tree_node *node1,
+                   unsigned t2, struct interval_tree_node *node2) {
+  bool res = progressions_overlap(node1, node2);
+#ifdef GLPK
+  if(interval_overlap_check && solve_mip(t1, node1, t2, node2) != res) {
+    interval_overlap_mismatches++;
+    mipmtx.lock();
+    fprintf(stderr, "SWORD: Overlap mismatch, [%zu, %zu] stride %u size %d and [%zu, %zu] stride %u size %d: %s, GLPK: %s.\n",
+            node1->start, node1->last, node1->diff, 1 << (node1->size_type >> 4),
+            node2->start, node2->last, node2->diff, 1 << (node2->size_type >> 4),
+            res ? "overlap" : "no overlap", res ? "no overlap" : "overlap");
+    mipmtx.unlock();
+  }
+#endif // GLPK
+  return res;
+}
+
+bool interval_tree_conflict(unsigned t1, struct interval_tree_node *node1,
+                            unsigned t2, struct interval_tree_node *node2) {
+  if(!RACE(node1, node2) || node1->start > node2->last || node2->start > node1->last)
+    return false;
+  if(node1->single() && node2->single())
+    return true;
+  if(node1->start >= node2->start)
+    return solve_overlap(t1, node1, t2, node2);
+  return solve_overlap(t2, node2, t1, node1);
+}
 
 }
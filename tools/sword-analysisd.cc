@@ -0,0 +1,187 @@
+// sword-analysisd: online analysis of a running program (SWORD_OPTIONS
+// online=1), started by the run-time on the shared memory segment of the
+// program, see rtl/sword_online.h.
+
+#include "rtl/sword_common.h"
+#include "rtl/sword_container.h"
+#include "rtl/sword_online.h"
+#include "sword-race-analysis.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+#include <sstream>
+#include <utility>
+
+// Barrier interval waiting for the other threads of its team.
+struct PendingInterval {
+  unsigned team;
+  std::map<unsigned, TraceInfo> traces;
+  uint64_t recorded;
+  uint64_t sampled_out;
+
+  PendingInterval() : team(0), recorded(0), sampled_out(0) {}
+};
+
+OnlineSegment *segment;
+ContainerReader container;
+std::map<std::pair<uint64_t, uint64_t>, PendingInterval> pending;
+uint64_t analyzed = 0;
+time_t sites_mtime = 0;
+
+// The run-time rewrites the sitefile when a module registers its sites.
+void reload_sites() {
+  struct stat st;
+  std::string dir = traces_data.string() + "/";
+  if(stat((dir + SITEFILE).c_str(), &st) == 0 && st.st_mtime != sites_mtime) {
+    sites_mtime = st.st_mtime;
+    load_sites(dir);
+  }
+}
+
+void analyze(std::pair<uint64_t, uint64_t> key, PendingInterval &interval) {
+  size_t known = races.size();
+  container.remap();
+  reload_sites();
+  analyze_barrier_interval(&container, interval.traces);
+  save_coverage(key.first, key.second, interval.recorded, interval.sampled_out);
+  for(const std::pair<const unsigned, TraceInfo> &t : interval.traces)
+    container.release(t.first, t.second.file_offset_begin, t.second.file_offset_end, !segment->keep_traces);
+  analyzed++;
+  if(races.size() > known) {
+    SaveReport(report_data.string() + "/" + ONLINE_REPORT);
+    INFO(std::cerr, "SWORD: " << races.size() - known << " new data race(s) in parallel region " << key.first << ", barrier interval " << key.second << " of '" << executable << "', see sword-print-report --report-path " << report_data.string() << ".");
+  }
+}
+
+void receive(unsigned tid, const OnlineMessage &m) {
+  if(m.kind == online_block) {
+    container.add(m.block);
+    return;
+  }
+  const IntervalRecord &r = m.interval;
+  std::pair<uint64_t, uint64_t> key(r.pid, r.bid);
+  std::map<std::pair<uint64_t, uint64_t>, PendingInterval>::iterator it = pending.find(key);
+  // A thread closes barrier interval 0 twice, when the region starts and at
+  // its first barrier: they are two intervals, the first one is over.
+  if(it != pending.end() && it->second.traces.count(tid)) {
+    analyze(key, it->second);
+    pending.erase(it);
+    it = pending.end();
+  }
+  if(it == pending.end())
+    it = pending.insert(std::make_pair(key, PendingInterval())).first;
+  PendingInterval &interval = it->second;
+  interval.team = m.team;
+  interval.traces[tid] = TraceInfo(r.begin, r.end);
+  interval.recorded += r.recorded;
+  interval.sampled_out += r.sampled_out;
+  if(interval.traces.size() >= interval.team) {
+    analyze(key, interval);
+    pending.erase(it);
+  }
+}
+
+// Drains the rings, returns the number of messages.
+size_t poll() {
+  size_t n = 0;
+  unsigned threads = std::min<unsigned>(segment->threads.load(std::memory_order_acquire), ONLINE_MAX_THREADS);
+  for(unsigned tid = 0; tid < threads; tid++) {
+    OnlineRing *r = &segment->rings[tid];
+    uint64_t head = r->head.load(std::memory_order_relaxed);
+    uint64_t tail = r->tail.load(std::memory_order_acquire);
+    for(; head < tail; head++, n++) {
+      OnlineMessage m = r->messages[head % ONLINE_RING_SIZE];
+      r->head.store(head + 1, std::memory_order_release);
+      receive(tid, m);
+    }
+  }
+  return n;
+}
+
+void pin(const std::string &cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  std::istringstream list(cpus);
+  std::string cpu;
+  while(std::getline(list, cpu, ','))
+    CPU_SET(std::stoi(cpu), &set);
+  if(sched_setaffinity(0, sizeof(set), &set) != 0)
+    INFO(std::cerr, "SWORD: sword-analysisd could not run on cpus " << cpus << ".");
+}
+
+int main(int argc, char **argv) {
+  std::string segment_name;
+  std::string cpus;
+
+  for(int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--segment" && i + 1 < argc) {
+      segment_name = argv[++i];
+    } else if (std::string(argv[i]) == "--report-path" && i + 1 < argc) {
+      report_data = argv[++i];
+    } else if (std::string(argv[i]) == "--cpus" && i + 1 < argc) {
+      cpus = argv[++i];
+    } else {
+      INFO(std::cout, "Usage:\n\n  " << argv[0] << " " << "--segment <shared-memory-segment> --report-path <path-to-report-folder> [--cpus <cpu-list>]\n\nIt is started by the Sword run-time with SWORD_OPTIONS=\"online=1\".\n");
+      return -1;
+    }
+  }
+  if(segment_name.empty() || report_data.empty()) {
+    INFO(std::cerr, "--segment and --report-path are required.");
+    return -1;
+  }
+
+  if(!codec_init()) {
+    INFO(std::cerr, "Internal error - lzo_init() failed!");
+    exit(-1);
+  }
+  if(!cpus.empty())
+    pin(cpus);
+
+  int fd = shm_open(segment_name.c_str(), O_RDWR, 0600);
+  void *m = (fd < 0) ? MAP_FAILED : mmap(NULL, sizeof(OnlineSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(fd >= 0)
+    close(fd);
+  if(m == MAP_FAILED) {
+    INFO(std::cerr, "SWORD: Error opening the shared memory segment " << segment_name << " - " << strerror(errno) << ".");
+    return -1;
+  }
+  segment = (OnlineSegment *) m;
+  if(memcmp(segment->magic, ONLINE_MAGIC, sizeof(segment->magic)) != 0 || segment->version != ONLINE_VERSION) {
+    INFO(std::cerr, "SWORD: " << segment_name << " is not a segment of this version of Sword.");
+    return -1;
+  }
+  executable = segment->executable;
+  traces_data = segment->traces_path;
+  if(!container.open_live(traces_data.string())) {
+    INFO(std::cerr, "SWORD: Error opening the trace container in: " << traces_data.string() << ".");
+    return -1;
+  }
+  boost::filesystem::create_directories(report_data);
+
+  while(true) {
+    // Everything published before done is in the rings.
+    bool done = segment->done.load(std::memory_order_acquire);
+    if(poll() == 0) {
+      if(done)
+        break;
+      usleep(1000);
+    }
+  }
+
+  // Intervals whose team did not publish them all, e.g. threads beyond
+  // ONLINE_MAX_THREADS.
+  for(std::pair<const std::pair<uint64_t, uint64_t>, PendingInterval> &interval : pending)
+    analyze(interval.first, interval.second);
+  pending.clear();
+
+  boost::filesystem::path sites = traces_data / SITEFILE;
+  if(boost::filesystem::exists(sites))
+    boost::filesystem::copy_file(sites, report_data / SITEFILE, boost::filesystem::copy_option::overwrite_if_exists);
+  INFO(std::cerr, "SWORD: sword-analysisd analyzed " << analyzed << " barrier intervals and found " << races.size() << " data race(s).");
+  munmap(segment, sizeof(OnlineSegment));
+  return 0;
+}
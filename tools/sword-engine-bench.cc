@@ -0,0 +1,138 @@
+//===-- sword-engine-bench.cc ----------------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Compares the engines of sword-race-analysis (--engine tree|sweep) on a
+// synthetic barrier interval: 8 threads of 600k accesses, strided writes of
+// every thread to its own range, random reads of a shared table and random
+// reads of a small one, and a write of every thread to the shared table
+// that races with the reads of the other threads at that address. The
+// container is written to the directory on the first run. Prints the racy
+// pc pairs reported and expected, the time and the peak RSS; run it once
+// per engine, the peak RSS is the one of the process.
+//===----------------------------------------------------------------------===//
+
+#include "sword-race-analysis.h"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <random>
+#include <set>
+
+#define BENCH_THREADS	8
+#define BENCH_BLOCKS	60
+#define BENCH_ITEMS		10000
+#define TABLE_BASE		0x10000000
+#define TABLE_ENTRIES	4000000
+#define RACY_BLOCK		7
+
+static size_t racy_address(unsigned t) {
+  return TABLE_BASE + (t * 977 % TABLE_ENTRIES) * 8;
+}
+
+// The items of block b of thread t, and the reads of the shared table
+// through read.
+template<typename F>
+static void generate_block(unsigned t, int b, F read, std::vector<TraceItem> *items) {
+  std::mt19937_64 rng(t * 1000 + b);
+  for(int i = 0; i < BENCH_ITEMS; i++) {
+    if(i % 4 == 0) {
+      size_t address = TABLE_BASE + (rng() % TABLE_ENTRIES) * 8;
+      read(address, 0x100 + i % 50);
+      if(items)
+        items->push_back(TraceItem(data_access, Access(size8, unsafe_read, address, 0x100 + i % 50)));
+    } else if(i % 4 == 1) {
+      if(items)
+        items->push_back(TraceItem(data_access, Access(size8, unsafe_write, 0x40000000 + t * 0x1000000 + (size_t) (b * BENCH_ITEMS + i) * 8, 0x200)));
+    } else {
+      size_t address = 0x80000000 + (size_t) (rng() % 100000) * 4;
+      if(items)
+        items->push_back(TraceItem(data_access, Access(size4, unsafe_read, address, 0x300 + t)));
+    }
+  }
+  if(items && b == RACY_BLOCK)
+    items->push_back(TraceItem(data_access, Access(size8, unsafe_write, racy_address(t), 0x400 + t)));
+}
+
+static bool generate(const std::string &dir) {
+  TraceContainer container;
+  if(!container.open(dir, 1 << 20))
+    return false;
+  BlockEncoder encoder;
+  std::vector<unsigned char> encoded(ENCODED_LEN);
+  for(unsigned t = 0; t < BENCH_THREADS; t++) {
+    TraceStream *stream = container.stream(t);
+    size_t offset = 0;
+    for(int b = 0; b < BENCH_BLOCKS; b++) {
+      std::vector<TraceItem> items;
+      generate_block(t, b, [](size_t, unsigned) {}, &items);
+      size_t len = encoder.encode(items.data(), items.size(), encoded.data(), block_columnar);
+      size_t bound = codec_bound(codec_lz4, len);
+      unsigned char *buffer = container.reserve(stream, bound);
+      if(!buffer)
+        return false;
+      size_t out = codec_compress(codec_lz4, 1, encoded.data(), len, buffer, bound);
+      container.commit(stream, codec_lz4, out, len, items.size(), &offset);
+    }
+    stream->interval(1, 0, 0, t, BENCH_THREADS, 1, 0, offset, 0, 0);
+  }
+  return container.finalize();
+}
+
+// Racy pc pairs, from the reads of the other threads at the racy address
+// of every thread.
+static size_t expected_pairs() {
+  std::set<std::pair<unsigned, unsigned>> pairs;
+  for(unsigned t = 0; t < BENCH_THREADS; t++) {
+    for(int b = 0; b < BENCH_BLOCKS; b++) {
+      generate_block(t, b, [t, &pairs](size_t address, unsigned pc) {
+          for(unsigned w = 0; w < BENCH_THREADS; w++) {
+            if(w != t && address == racy_address(w))
+              pairs.insert(std::make_pair(0x400 + w, pc));
+          }
+        }, NULL);
+    }
+  }
+  return pairs.size();
+}
+
+int main(int argc, char **argv) {
+  if(argc != 3 || (strcmp(argv[2], "tree") != 0 && strcmp(argv[2], "sweep") != 0)) {
+    fprintf(stderr, "Usage: %s <traces-dir> tree|sweep\n", argv[0]);
+    return 1;
+  }
+  std::string dir = std::string(argv[1]) + "/";
+  engine = (strcmp(argv[2], "sweep") == 0) ? engine_sweep : engine_tree;
+  codec_init();
+
+  ContainerReader container;
+  if(!container.open(dir)) {
+    if(!generate(dir) || !container.open(dir)) {
+      fprintf(stderr, "SWORD: Could not write the trace container in %s.\n", dir.c_str());
+      return 1;
+    }
+  }
+  size_t expected = expected_pairs();
+
+  std::map<unsigned, TraceInfo> traces;
+  std::pair<const IntervalRecord *, const IntervalRecord *> intervals = container.find(1, 0);
+  for(const IntervalRecord *r = intervals.first; r != intervals.second; ++r)
+    traces[r->tid] = TraceInfo(r->begin, r->end);
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  analyze_barrier_interval(&container, traces);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("%s: %zu of %zu racy pc pairs, %.2f s, peak RSS %ld MB.\n", argv[2], races.size(), expected,
+         seconds, usage.ru_maxrss / 1024);
+  return 0;
+}
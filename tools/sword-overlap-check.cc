@@ -0,0 +1,132 @@
+//===-- sword-overlap-check.cc ---------------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file is a part of Sword/Sword, an OpenMP race detector.
+//
+// Cross-checks the closed-form overlap test of strided intervals
+// (solve_overlap in interval_tree_generic.h) on random pairs of intervals
+// against an access by access search, and in GLPK builds against solve_mip
+// for the first pairs. Prints the pairs, overlaps and mismatches, and fails
+// if there is any mismatch. interval_tree_conflict only calls the test on
+// intervals whose start addresses overlap, the pairs here are arbitrary.
+//===----------------------------------------------------------------------===//
+
+#include "interval_tree.h"
+#include "interval_tree_generic.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+
+// Pairs also solved with GLPK, the MIP is slow.
+#define GLPK_PAIRS 2000
+
+struct Progression {
+  int64_t start;
+  int64_t diff;
+  int64_t count;
+  int64_t width;
+};
+
+// Whether some access of p1 shares a byte with an access of p2, by walking
+// the bytes of p1.
+static bool search_overlap(const Progression &p1, const Progression &p2) {
+  for(int64_t x1 = 0; x1 < p1.count; x1++) {
+    for(int64_t a = p1.start + p1.diff * x1; a < p1.start + p1.diff * x1 + p1.width; a++) {
+      if(p2.diff == 0) {
+        if(p2.start <= a && a < p2.start + p2.width)
+          return true;
+        continue;
+      }
+      // Accesses x2 of p2 with start2 + diff2 * x2 <= a < start2 + diff2 * x2 + width2.
+      int64_t hi = a - p2.start;
+      int64_t lo = a - p2.start - p2.width + 1;
+      int64_t first = lo <= 0 ? 0 : (lo + p2.diff - 1) / p2.diff;
+      int64_t last = hi < 0 ? -1 : std::min(p2.count - 1, hi / p2.diff);
+      if(first <= last)
+        return true;
+    }
+  }
+  return false;
+}
+
+static interval_tree_node make_node(const Progression &p) {
+  uint8_t size = 0;
+  while((1 << size) < p.width)
+    size++;
+  interval_tree_node n(p.start, p.start + p.diff * (p.count - 1), (size << 4) | unsafe_write, 0, 0);
+  n.diff = p.diff;
+  return n;
+}
+
+// Short progressions near each other, or long ones with large strides far
+// apart, so that both the gcd and the bounds decide.
+static Progression random_progression(std::mt19937_64 &rng, bool wide) {
+  Progression p;
+  p.width = 1 << (rng() % 4);
+  if(!wide) {
+    p.start = rng() % 512;
+    p.diff = (rng() % 4 == 0) ? 0 : p.width + rng() % 48;
+    p.count = p.diff ? 1 + rng() % 40 : 1;
+  } else {
+    p.start = (1LL << 40) + rng() % (1LL << 20);
+    p.diff = p.width + rng() % (1 << 12);
+    p.count = 1 + rng() % 2000;
+  }
+  return p;
+}
+
+int main(int argc, char **argv) {
+  uint64_t pairs = 200000;
+  uint64_t seed = 1;
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--pairs") == 0 && i + 1 < argc)
+      pairs = strtoull(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+      seed = strtoull(argv[++i], NULL, 10);
+    else {
+      fprintf(stderr, "Usage: %s [--pairs <n>] [--seed <n>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::mt19937_64 rng(seed);
+  uint64_t overlaps = 0, mismatches = 0;
+  for(uint64_t i = 0; i < pairs; i++) {
+    bool wide = (i % 8 == 7);
+    Progression p1 = random_progression(rng, wide);
+    Progression p2 = random_progression(rng, wide);
+    interval_tree_node n1 = make_node(p1);
+    interval_tree_node n2 = make_node(p2);
+#ifdef GLPK
+    interval_overlap_check = (i < GLPK_PAIRS);
+#endif
+    // The first node starts last, as in interval_tree_conflict.
+    bool res = (n1.start >= n2.start) ? solve_overlap(0, &n1, 1, &n2) : solve_overlap(1, &n2, 0, &n1);
+    bool expected = search_overlap(p1, p2);
+    overlaps += expected;
+    if(res != expected) {
+      mismatches++;
+      printf("SWORD: Overlap mismatch, [%ld, +%ld x %ld] size %ld and [%ld, +%ld x %ld] size %ld: %s, search: %s.\n",
+             p1.start, p1.diff, p1.count, p1.width, p2.start, p2.diff, p2.count, p2.width,
+             res ? "overlap" : "no overlap", expected ? "overlap" : "no overlap");
+    }
+  }
+  printf("SWORD: %lu pairs of strided intervals, %lu overlap, %lu mismatches.\n", pairs, overlaps, mismatches);
+#ifdef GLPK
+  printf("SWORD: GLPK solved %lu pairs, %lu mismatches.\n", std::min<uint64_t>(pairs, GLPK_PAIRS),
+         interval_overlap_mismatches.load());
+  mismatches += interval_overlap_mismatches;
+#endif
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,233 @@
+// Staged loader of the interval trees of a barrier interval:
+//
+//   read-ahead -> decompress and decode -> tree build
+//
+// The blocks of all the threads are scheduled together, interleaved in
+// proportion to the blocks of every thread, so that the longest stream,
+// usually the one of the master, does not come last. The read-ahead thread
+// asks the kernel for the pages of the blocks, at most readahead blocks in
+// front of the decoders. Any decoder takes the next block of any thread; at
+// most `buffers` decoded blocks wait for their tree, a decoder without a
+// buffer waits for the builders. A tree takes its blocks in stream order
+// and one builder at a time, the lockset of its thread carries from one
+// block to the next; a free builder takes the tree with the most blocks
+// left. The blocks go to an interval tree, or to any other consumer of the
+// items of a thread.
+
+#ifndef SWORD_PIPELINE_H
+#define SWORD_PIPELINE_H
+
+#include "rtl/sword_block.h"
+#include "rtl/sword_codec.h"
+#include "rtl/sword_common.h"
+#include "rtl/sword_container.h"
+#include "sword-tree-analysis.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Workers of every stage, 0 for the default.
+struct LoaderOptions {
+  unsigned readahead;      // blocks, default twice the decoders
+  unsigned decode_threads; // default one per core
+  unsigned tree_threads;   // default one per tree, at most one per core
+};
+
+LoaderOptions loader_options = { 0, 0, 0 };
+
+// Decompresses and decodes a block of thread t into items.
+void decode_trace_block(const ContainerReader *container, const BlockIndexEntry &block, unsigned t,
+                        std::vector<unsigned char> &scratch, std::vector<TraceItem> &items) {
+  const BlockHeader *header = container->block(block);
+  if(!header) {
+    printf("Corrupt or truncated block at offset %lu of thread %u\n", block.offset, t);
+    exit(-1);
+  }
+  // The codec of every block is in its header
+  const unsigned char *data = (const unsigned char *) (header + 1);
+  const unsigned char *decoded = data;
+  size_t new_len = header->compressed_len;
+  if(header->codec != codec_none) {
+    decoded = scratch.data();
+    long r = codec_decompress(header->codec, data, header->compressed_len, scratch.data(), scratch.size());
+    if(r < 0) {
+      printf("Decompression failed for a block of thread %u with codec %s\n", t, codec_name(header->codec));
+      exit(-1);
+    }
+    new_len = r;
+  }
+
+  items.resize(NUM_OF_ACCESSES);
+  long nitems = -1;
+  if(new_len == header->uncompressed_len)
+    nitems = decode_block(decoded, new_len, items.data());
+  if(nitems < 0 || nitems != header->nitems) {
+    printf("Error decoding block of thread %u\n", t);
+    exit(-1);
+  }
+  items.resize(nitems);
+}
+
+// Takes the decoded items of a thread in stream order, with the lockset of
+// the thread.
+typedef std::function<void(const TraceItem *, const TraceItem *, std::set<size_t> &)> TraceSink;
+
+class TraceLoader {
+ private:
+  struct Job {
+    unsigned tree;
+    size_t seq; // in the stream of the thread
+    BlockIndexEntry block;
+  };
+
+  struct Tree {
+    unsigned tid;
+    TraceSink sink;
+    std::set<size_t> mutex;
+    size_t blocks;
+    size_t next;
+    bool busy;
+    std::map<size_t, std::vector<TraceItem> *> decoded;
+  };
+
+  const ContainerReader *container;
+  std::vector<Tree> trees;
+  std::vector<Job> jobs;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  size_t prefetched;
+  size_t dispatched;
+  size_t inserted;
+  std::vector<std::vector<TraceItem> *> buffers;
+  unsigned readahead;
+
+  void prefetch_run() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while(prefetched < jobs.size()) {
+      if(prefetched >= dispatched + readahead) {
+        cv.wait(lock);
+        continue;
+      }
+      const BlockIndexEntry &block = jobs[prefetched++].block;
+      lock.unlock();
+      container->prefetch(block);
+      lock.lock();
+    }
+  }
+
+  void decode_run() {
+    std::vector<unsigned char> scratch(ENCODED_LEN);
+    std::unique_lock<std::mutex> lock(mtx);
+    while(dispatched < jobs.size()) {
+      if(buffers.empty()) {
+        cv.wait(lock);
+        continue;
+      }
+      const Job &job = jobs[dispatched++];
+      std::vector<TraceItem> *items = buffers.back();
+      buffers.pop_back();
+      cv.notify_all();
+      lock.unlock();
+      decode_trace_block(container, job.block, trees[job.tree].tid, scratch, *items);
+      lock.lock();
+      trees[job.tree].decoded[job.seq] = items;
+      cv.notify_all();
+    }
+  }
+
+  void tree_run() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while(inserted < jobs.size()) {
+      Tree *tree = NULL;
+      for(Tree &t : trees) {
+        if(!t.busy && !t.decoded.empty() && t.decoded.begin()->first == t.next &&
+           (!tree || t.blocks - t.next > tree->blocks - tree->next))
+          tree = &t;
+      }
+      if(!tree) {
+        cv.wait(lock);
+        continue;
+      }
+      tree->busy = true;
+      std::vector<TraceItem> *items = tree->decoded.begin()->second;
+      tree->decoded.erase(tree->decoded.begin());
+      lock.unlock();
+      tree->sink(items->data(), items->data() + items->size(), tree->mutex);
+      lock.lock();
+      tree->next++;
+      tree->busy = false;
+      inserted++;
+      buffers.push_back(items);
+      cv.notify_all();
+    }
+  }
+
+ public:
+  // size_type of every access site, indexed by site id.
+  const std::vector<uint8_t> &site_size_types;
+
+  TraceLoader(const ContainerReader *c, const std::vector<uint8_t> &size_types)
+    : container(c), prefetched(0), dispatched(0), inserted(0), readahead(0), site_size_types(size_types) {}
+
+  ~TraceLoader() {
+    for(std::vector<TraceItem> *items : buffers)
+      delete items;
+  }
+
+  // The blocks of thread tid in [begin, end) of its stream go to root.
+  void add(unsigned tid, uint64_t begin, uint64_t end, interval_tree_root *root) {
+    const std::vector<uint8_t> &size_types = site_size_types;
+    add(tid, begin, end, [tid, root, &size_types](const TraceItem *first, const TraceItem *last, std::set<size_t> &mutex) {
+        insert_items(first, last, mutex, size_types, root, tid);
+      });
+  }
+
+  // The blocks of thread tid in [begin, end) of its stream go to sink.
+  void add(unsigned tid, uint64_t begin, uint64_t end, TraceSink sink) {
+    Tree tree;
+    tree.tid = tid;
+    tree.sink = sink;
+    tree.blocks = 0;
+    tree.next = 0;
+    tree.busy = false;
+    if(end > begin) {
+      for(const BlockIndexEntry &block : container->blocks(tid, begin, end))
+        jobs.push_back({ (unsigned) trees.size(), tree.blocks++, block });
+    }
+    trees.push_back(tree);
+  }
+
+  void run(const LoaderOptions &options) {
+    if(jobs.empty())
+      return;
+    // The k-th block of a thread with n blocks at (k + 1/2) / n.
+    std::stable_sort(jobs.begin(), jobs.end(), [this](const Job &a, const Job &b) {
+        return (2 * a.seq + 1) * trees[b.tree].blocks < (2 * b.seq + 1) * trees[a.tree].blocks;
+      });
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    unsigned decode_threads = options.decode_threads ? options.decode_threads : cores;
+    unsigned tree_threads = options.tree_threads ? options.tree_threads : std::min<unsigned>(trees.size(), cores);
+    readahead = options.readahead ? options.readahead : 2 * decode_threads;
+    for(unsigned i = 0; i < decode_threads + tree_threads; i++)
+      buffers.push_back(new std::vector<TraceItem>());
+
+    std::vector<std::thread> threads;
+    threads.push_back(std::thread(&TraceLoader::prefetch_run, this));
+    for(unsigned i = 0; i < decode_threads; i++)
+      threads.push_back(std::thread(&TraceLoader::decode_run, this));
+    for(unsigned i = 0; i < tree_threads; i++)
+      threads.push_back(std::thread(&TraceLoader::tree_run, this));
+    for(std::thread &thread : threads)
+      thread.join();
+  }
+};
+
+#endif // SWORD_PIPELINE_H
@@ -5,10 +5,57 @@
 #include <boost/range/iterator_range.hpp>
 #include <boost/filesystem.hpp>
 
+#include <iomanip>
+
+// "function at file:line:column" for every access site, by site id.
+std::map<unsigned, std::string> sites;
+
+void LoadSites() {
+  std::ifstream file((report_data / SITEFILE).string());
+  std::string str;
+  while(std::getline(file, str)) {
+    unsigned id, size_type, line, column;
+    char function[4096], filename[4096];
+    if(sscanf(str.c_str(), "%u,%u,%u,%u,%4095[^,],%4095[^\n]", &id, &size_type, &line, &column, function, filename) == 6)
+      sites[id] = std::string(function) + " at " + filename + ":" + std::to_string(line) + ":" + std::to_string(column);
+  }
+}
+
+void Symbolize(uint64_t pc, std::string *result) {
+  if(pc & SITE_PC_FLAG) {
+    std::map<unsigned, std::string>::const_iterator site = sites.find((unsigned) (pc & ~SITE_PC_FLAG));
+    *result = (site != sites.end()) ? site->second : "??";
+    return;
+  }
+  std::string command = shell_path + " -c '" + symbolizer_path + " -pretty-print" + " < <(echo \"" + executable + " " + std::to_string(pc) + "\")'";
+  execute_command(command.c_str(), result, 2);
+}
+
+// Coverage of the parallel regions traced with sampling=1.
+void PrintCoverage(const boost::filesystem::path &path) {
+  std::ifstream file(path.string());
+  std::string str;
+  uint64_t recorded = 0;
+  uint64_t sampled_out = 0;
+  while(std::getline(file, str)) {
+    uint64_t bid, r, s;
+    if(sscanf(str.c_str(), COVERAGE_FORMAT, &bid, &r, &s) == 3) {
+      recorded += r;
+      sampled_out += s;
+    }
+  }
+  std::string pregion = path.filename().string().substr(strlen(COVERAGE_FILE));
+  INFO(std::cerr, "SWORD: Parallel region " << pregion << " was sampled, the analysis covered " << recorded << " of " << recorded + sampled_out << " accesses (" << std::fixed << std::setprecision(1) << 100.0 * recorded / (recorded + sampled_out) << "%).");
+}
+
 void PrintReport() {
   size_t current_size = 0;
+  LoadSites();
   for(auto& entry : boost::make_iterator_range(boost::filesystem::directory_iterator(report_data), {})) {
-    if(entry.path().string().find("overhead") == std::string::npos && entry.path().string().find("time_cluster") == std::string::npos) {
+    if(boost::algorithm::starts_with(entry.path().filename().string(), COVERAGE_FILE)) {
+      PrintCoverage(entry.path());
+    } else if(entry.path().string().find("overhead") == std::string::npos && entry.path().string().find("time_cluster") == std::string::npos &&
+       entry.path().filename().string() != SITEFILE) {
       size_t filesize = boost::filesystem::file_size(entry.path());
       if(filesize > 0) {
         std::ifstream file(entry.path().string(), std::ios::in | std::ios::binary);
@@ -43,15 +90,8 @@ void PrintReport() {
       std::string race1 = "";
       std::string race2 = "";
 
-      {
-        std::string command = shell_path + " -c '" + symbolizer_path + " -pretty-print" + " < <(echo \"" + executable + " " + std::to_string(race->pc1) + "\")'";
-        execute_command(command.c_str(), &race1, 2);
-      }
-
-      {
-        std::string command = shell_path + " -c '" + symbolizer_path + " -pretty-print" + " < <(echo \"" + executable + " " + std::to_string(race->pc2) + "\")'";
-        execute_command(command.c_str(), &race2, 2);
-      }
+      Symbolize(race->pc1, &race1);
+      Symbolize(race->pc2, &race2);
 
       INFO(std::cerr, "--------------------------------------------------");
       INFO(std::cerr, "WARNING: SWORD: data race (program=" << executable << ")");
@@ -1,222 +1,136 @@
 #include "rtl/sword_common.h"
+#include "rtl/sword_block.h"
+#include "rtl/sword_container.h"
 #include "interval_tree.h"
 #include "sword-race-analysis.h"
+#include "sword-scheduler.h"
 #include <boost/algorithm/string.hpp>
 
-#define PRINT_RACE 0
-
-#ifdef SNAPPY
-#include "../rtl/snappy.h"
-#endif
-
-#ifdef LZ4
-#include "../rtl/lz4.h"
+#ifdef GLPK
+#include <glpk.h>
 #endif
 
 #include <sched.h>
+#include <sys/resource.h>
 #include <stdio.h>
 #include <unistd.h>
 
 #include <atomic>
 #include <algorithm>
+#include <chrono>
 #include <list>
 #include <map>
 #include <thread>
 
 #include <boost/lockfree/queue.hpp>
 
-struct TreeRoot {
-  unsigned tid;
-  rb_root *root;
-
-  TreeRoot(int id, rb_root *r) {
-    tid = id;
-    root = r;
-  }
-};
-
-void SaveReport(std::string filename) {
-  std::ofstream file(filename, std::ios::out | std::ios::binary);
-  size_t size = races.size();
-  file.write((char*) &size, sizeof(size));
-  file.write(reinterpret_cast<char*>(races.data()), races.size() * sizeof(RaceInfo));
-  file.close();
-}
-
-void ReportRace(uint64_t address, uint8_t rw1, uint8_t rw2, uint8_t size1, uint8_t size2, uint64_t pc1, uint64_t pc2) {
-  std::size_t hash1 = 0;
-  boost::hash_combine(hash1, pc1);
-  boost::hash_combine(hash1, pc2);
-  std::size_t hash2 = 0;
-  boost::hash_combine(hash2, pc2);
-  boost::hash_combine(hash2, pc1);
-  rmtx.lock();
-  const bool reported = (hash_races.find(hash1) != hash_races.end()) || (hash_races.find(hash2) != hash_races.end());
-  rmtx.unlock();
-  if(!reported) {
-    rmtx.lock();
-    hash_races.insert(hash1);
-    hash_races.insert(hash2);
-    races.push_back(RaceInfo(address, rw1, size1, pc1, rw2, size2, pc2));
-    rmtx.unlock();
-
-#if PRINT_RACE
-    std::string race1 = "";
-    std::string race2 = "";
-
-    {
-      std::string command = shell_path + " -c '" + symbolizer_path + " -pretty-print" + " < <(echo \"" + executable + " " + std::to_string(pc1) + "\")'";
-      execute_command(command.c_str(), &race1, 2);
-    }
-
-    {
-      std::string command = shell_path + " -c '" + symbolizer_path + " -pretty-print" + " < <(echo \"" + executable + " " + std::to_string(pc2) + "\")'";
-      execute_command(command.c_str(), &race2, 2);
+#define OFFLINE_REPORT "race_report_offline"
+// Estimated bytes of an item for each engine. A tree node comes from the
+// arenas without a header. The sweep keeps 33 bytes per interval in vectors
+// that grow by doubling, and sorts them with index arrays and a copy of
+// every field, about twice a node.
+#define NODE_BYTES sizeof(interval_tree_node)
+#define SWEEP_BYTES (2 * NODE_BYTES)
+
+// --stats, how the blocks were written: their items, per codec from their
+// headers and per format from the first byte of their data, and the
+// accesses the sampling left out.
+void print_container_stats(const ContainerReader &container) {
+  uint64_t codecs[NUM_CODECS] = {};
+  uint64_t formats[block_columnar + 1] = {};
+  uint64_t items = 0;
+  uint64_t corrupt = 0;
+  std::vector<unsigned char> scratch(ENCODED_LEN);
+  for(const BlockIndexEntry &e : container.index) {
+    const BlockHeader *header = container.block(e);
+    long len = -1;
+    if(header && header->codec < NUM_CODECS && header->uncompressed_len <= scratch.size())
+      len = codec_decompress(header->codec, (const unsigned char *) (header + 1), header->compressed_len,
+                             scratch.data(), scratch.size());
+    if(len < 1 || scratch[0] > block_columnar) {
+      corrupt++;
+      continue;
     }
-
-    INFO(std::cerr, "--------------------------------------------------");
-    INFO(std::cerr, "WARNING: SWORD: data race (program=" << executable << ")");
-    INFO(std::cerr, AccessTypeStrings[rw1] << " of size " << std::dec << (1 << size1) << " at 0x" << std::hex << address << " in " << race1);
-    INFO(std::cerr, AccessTypeStrings[rw2] << " of size " << std::dec << (1 << size2) << " at 0x" << std::hex << address << " in " << race2);
-    INFO(std::cerr, "--------------------------------------------------");
-    INFO(std::cerr, "");
-#endif
+    items += header->nitems;
+    codecs[header->codec]++;
+    formats[scratch[0]]++;
   }
-}
-
-unsigned long long getTotalSystemMemory()
-{
-  long pages = sysconf(_SC_PHYS_PAGES);
-  long page_size = sysconf(_SC_PAGE_SIZE);
-  return pages * page_size;
-}
-
-void analyze_trees(bool last, unsigned t1, rb_root *tree1, unsigned t2, rb_root *tree2,
-     std::vector<std::pair<interval_tree_node,interval_tree_node>> &races) {
-  if(tree1 && tree2) {
-    interval_tree_overlap(rmtx, t1, tree1, t2, tree2, races);
-    if(!last)
-      interval_tree_merge(tree1, tree2);
+  std::stringstream blocks;
+  blocks << "SWORD: " << container.index.size() << " blocks, " << items << " items, codecs:";
+  for(unsigned c = 0; c < NUM_CODECS; c++)
+    if(codecs[c])
+      blocks << " " << codec_name(c) << " " << codecs[c];
+  blocks << ", formats:";
+  if(formats[block_raw])
+    blocks << " raw " << formats[block_raw];
+  if(formats[block_columnar])
+    blocks << " columnar " << formats[block_columnar];
+  if(corrupt)
+    blocks << ", " << corrupt << " corrupt";
+  INFO(std::cout, blocks.str() << ".");
+
+  uint64_t recorded = 0;
+  uint64_t sampled_out = 0;
+  for(size_t i = 0; i < container.interval_count; i++) {
+    recorded += container.intervals[i].recorded;
+    sampled_out += container.intervals[i].sampled_out;
   }
+  INFO(std::cout, "SWORD: " << container.interval_count << " interval records, " << recorded << " accesses recorded, "
+       << sampled_out << " sampled out.");
 }
 
-void load_and_convert_file(boost::filesystem::path path, unsigned t, uint64_t fob, uint64_t foe, rb_root *interval_tree_root) {
-  std::string filename(path.string() + "/datafile_" + std::to_string(t));
-  uint64_t filesize = foe - fob;
-  uint64_t out_len;
-  uint64_t new_len;
-
-  if(filesize > 0) {
-    FILE *datafile = fopen(filename.c_str(), "r");
-    if (!datafile) {
-      INFO(std::cerr, "SWORD: Error opening file: " << filename << " - " << strerror(errno) << ".");
-      exit(-1);
+// Analyzes all the barrier intervals of the container on a pool of jobs
+// workers (sword-scheduler.h), the largest first. The memory of an interval
+// is estimated from the items of its blocks. Returns the intervals.
+size_t analyze_all_intervals(const ContainerReader &container, unsigned jobs, uint64_t memory) {
+  WorkStealingPool pool(jobs, memory);
+  uint64_t buffers = (loader_options.decode_threads + loader_options.tree_threads) * NUM_OF_ACCESSES * sizeof(TraceItem);
+  uint64_t item_bytes = (engine == engine_sweep) ? SWEEP_BYTES : NODE_BYTES;
+  size_t count = 0;
+  const IntervalRecord *end = container.intervals + container.interval_count;
+  for(const IntervalRecord *r = container.intervals; r != end; count++) {
+    uint64_t pid = r->pid;
+    uint64_t bid = r->bid;
+    std::map<unsigned, TraceInfo> traces;
+    uint64_t recorded = 0;
+    uint64_t sampled_out = 0;
+    uint64_t size = 0;
+    uint64_t items = 0;
+    for(; r != end && r->pid == pid && r->bid == bid; ++r) {
+      traces[r->tid] = TraceInfo(r->begin, r->end);
+      recorded += r->recorded;
+      sampled_out += r->sampled_out;
     }
-
-    unsigned char compressed_buffer[OUT_LEN];
-    // TraceItem *uncompressed_buffer = (TraceItem *) malloc(BLOCK_SIZE);
-    TraceItem uncompressed_buffer[NUM_OF_ACCESSES];
-
-    uint64_t block_size;
-    fseek(datafile, fob, SEEK_SET);
-    size_t size = fread(&block_size, sizeof(uint64_t), 1, datafile);
-    unsigned neof = 0;
-
-    if(block_size + sizeof(uint64_t) < filesize) {
-      block_size += sizeof(uint64_t);
-      neof = 1;
+    for(const std::pair<const unsigned, TraceInfo> &t : traces) {
+      size += t.second.file_offset_end - t.second.file_offset_begin;
+      for(const BlockIndexEntry &e : container.blocks(t.first, t.second.file_offset_begin, t.second.file_offset_end))
+        items += container.items(e);
     }
-
-    size_t total_size = sizeof(uint64_t);
-    std::vector<TraceItem> file_buffer;
-    // size_t uncompressed_size = 0;
-    while(total_size < filesize) {
-      size_t ret = fread(compressed_buffer, 1, block_size, datafile);
-      total_size += block_size;
-      if(ret != block_size) {
-        printf("Error reading data from the file\n");
-        exit(-1);
-      }
-
-#if defined(LZO)
-      lzo_uint r = lzo1x_decompress(compressed_buffer, block_size - (sizeof(uint64_t) * neof), (unsigned char *) uncompressed_buffer, &new_len, NULL);
-      if (r != LZO_E_OK) {
-        /* this should NEVER happen */
-        printf("internal error - decompression failed: %lu\n", r);
-        exit(-1);
-      }
-#elif defined(SNAPPY)
-      snappy::GetUncompressedLength((char *) compressed_buffer, block_size - (sizeof(uint64_t) * neof), &new_len);
-      bool r = snappy::RawUncompress((char *) compressed_buffer, block_size - (sizeof(uint64_t) * neof), (char *) uncompressed_buffer);
-      if (!r) {
-        /* this should NEVER happen */
-        printf("internal error - decompression failed\n");
-        exit(-1);
-      }
-#elif defined(LZ4)
-      new_len = LZ4_decompress_safe((char *) compressed_buffer, (char *) uncompressed_buffer, block_size - (sizeof(uint64_t) * neof), BLOCK_SIZE);
-#else
-#endif
-
-      // uncompressed_size += new_len;
-
-      file_buffer.insert(file_buffer.end(), uncompressed_buffer, uncompressed_buffer + (new_len / sizeof(TraceItem)));
-
-      std::set<size_t> mutex;
-      for(std::vector<TraceItem>::const_iterator it = file_buffer.begin(); it != file_buffer.end(); ++it) {
-        switch(it->getType()) {
-        case data_access:
-          interval_tree_insert_data(interval_tree_node(it->data.access.address, it->data.access.address, it->data.access.size_type, (size_t) it->data.access.pc.num, mutex), interval_tree_root, t);
-          break;
-        case mutex_acquired:
-          mutex.insert(it->data.mutex_region.getWaitId());
-          break;
-        case mutex_released:
-          mutex.erase(it->data.mutex_region.getWaitId());
-          break;
-        default:
-          break;
-        }
-      }
-
-      file_buffer.clear();
-
-      memcpy(&block_size, compressed_buffer + block_size - sizeof(uint64_t), sizeof(uint64_t));
-      if(total_size + block_size + sizeof(uint64_t) < filesize) {
-        block_size += sizeof(uint64_t);
-        neof = 1;
-      } else {
-        neof = 0;
-      }
-    }
-
-    // INFO(std::cout, "Total Size: " << uncompressed_size);
-    // free(uncompressed_buffer);
-
-    fclose(datafile);
-
+    pool.add(size, items * item_bytes + buffers, [&container, pid, bid, traces, recorded, sampled_out]() {
+        save_coverage(pid, bid, recorded, sampled_out);
+        // Races need two threads.
+        if(traces.size() > 1)
+          analyze_barrier_interval(&container, traces);
+      });
   }
+  pool.run();
+  INFO(std::cout, "SWORD: Analyzed " << count << " barrier intervals on " << jobs << " workers, " << pool.stolen << " stolen, " << pool.waited << " waited for memory, peak " << pool.peak / MB << " MB estimated.");
+  return count;
 }
 
 int main(int argc, char **argv) {
   std::string unknown_option = "";
-#ifdef PRINT
-  bool print = false;
-#endif // PRINT
+  bool single = false;
+  unsigned jobs = 0;
+  uint64_t memory = 0;
+  bool stats = false;
 
   if(argc < 7)
-    INFO(std::cout, "Usage:\n\n  " << argv[0] << " " << "--executable <path-to-executable-name> --traces-path <path-to-traces-folder> --report-path <path-to-report-folder>\n\n");
-
-  if (!glp_config("TLS")) {
-    printf("The loaded GLPK library does not support thread local memory.\n"
-           "You need a version of the library configured with "
-           "--enable-reentrant=yes to run this program.\n");
-    exit(EXIT_FAILURE);
-  }
+    INFO(std::cout, "Usage:\n\n  " << argv[0] << " " << "--executable <path-to-executable-name> --traces-path <path-to-traces-folder> --report-path <path-to-report-folder> [--pregion <id> --bid <id>] [--jobs <n>] [--memory <MB>] [--readahead <blocks>] [--decode-threads <n>] [--tree-threads <n>] [--engine tree|sweep] [--check-overlaps] [--stats]\n\nWithout --pregion and --bid it analyzes all the barrier intervals.\n\n");
 
   for(int i = 1; i < argc; ++i) {
     if (std::string(argv[i]) == "--help") {
-      INFO(std::cout, "Usage:\n\n  " << argv[0] << " " << "--executable <path-to-executable-name> --traces-path <path-to-traces-folder> --report-path <path-to-report-folder>\n\n");
+      INFO(std::cout, "Usage:\n\n  " << argv[0] << " " << "--executable <path-to-executable-name> --traces-path <path-to-traces-folder> --report-path <path-to-report-folder> [--pregion <id> --bid <id>] [--jobs <n>] [--memory <MB>] [--readahead <blocks>] [--decode-threads <n>] [--tree-threads <n>] [--engine tree|sweep] [--check-overlaps] [--stats]\n\nWithout --pregion and --bid it analyzes all the barrier intervals.\n\n");
       return 0;
     } else if (std::string(argv[i]) == "--report-path") {
       if (i + 1 < argc) {
@@ -242,6 +156,7 @@ int main(int argc, char **argv) {
     } else if (std::string(argv[i]) == "--pregion") {
       if (i + 1 < argc) {
         pregion = std::strtoull(argv[++i],NULL,0);
+        single = true;
       } else {
         INFO(std::cerr, "--pregion option requires one argument.");
         return -1;
@@ -249,6 +164,7 @@ int main(int argc, char **argv) {
     } else if (std::string(argv[i]) == "--bid") {
       if (i + 1 < argc) {
         barrier_id = std::strtoull(argv[++i],NULL,0);
+        single = true;
       } else {
         INFO(std::cerr, "--bid option requires one argument.");
         return -1;
@@ -260,6 +176,54 @@ int main(int argc, char **argv) {
         INFO(std::cerr, "--nested option requires one argument.");
         return -1;
       }
+    } else if (std::string(argv[i]) == "--jobs") {
+      if (i + 1 < argc) {
+        jobs = std::strtoul(argv[++i], NULL, 0);
+      } else {
+        INFO(std::cerr, "--jobs option requires one argument.");
+        return -1;
+      }
+    } else if (std::string(argv[i]) == "--memory") {
+      if (i + 1 < argc) {
+        memory = std::strtoull(argv[++i], NULL, 0) * 1024 * 1024;
+      } else {
+        INFO(std::cerr, "--memory option requires one argument.");
+        return -1;
+      }
+    } else if (std::string(argv[i]) == "--readahead" || std::string(argv[i]) == "--decode-threads" ||
+               std::string(argv[i]) == "--tree-threads") {
+      if (i + 1 < argc) {
+        unsigned value = std::strtoul(argv[i + 1], NULL, 0);
+        if (std::string(argv[i]) == "--readahead")
+          loader_options.readahead = value;
+        else if (std::string(argv[i]) == "--decode-threads")
+          loader_options.decode_threads = value;
+        else
+          loader_options.tree_threads = value;
+        i++;
+      } else {
+        INFO(std::cerr, argv[i] << " option requires one argument.");
+        return -1;
+      }
+    } else if (std::string(argv[i]) == "--engine") {
+      if (i + 1 < argc && std::string(argv[i + 1]) == "tree") {
+        engine = engine_tree;
+      } else if (i + 1 < argc && std::string(argv[i + 1]) == "sweep") {
+        engine = engine_sweep;
+      } else {
+        INFO(std::cerr, "--engine option requires one argument, tree or sweep.");
+        return -1;
+      }
+      i++;
+    } else if (std::string(argv[i]) == "--check-overlaps") {
+#ifdef GLPK
+      interval_overlap_check = true;
+#else
+      INFO(std::cerr, "--check-overlaps requires a build with GLPK.");
+      return -1;
+#endif // GLPK
+    } else if (std::string(argv[i]) == "--stats") {
+      stats = true;
 #ifdef PRINT
     } else if (std::string(argv[i]) == "--print") {
       print = true;
@@ -274,6 +238,15 @@ int main(int argc, char **argv) {
     return -1;
   }
 
+#ifdef GLPK
+  if (interval_overlap_check && !glp_config("TLS")) {
+    printf("The loaded GLPK library does not support thread local memory.\n"
+           "You need a version of the library configured with "
+           "--enable-reentrant=yes to run this program.\n");
+    exit(EXIT_FAILURE);
+  }
+#endif // GLPK
+
 #if PRINT_RACE
   // Look for shell
   execute_command(GET_SHELL, &shell_path);
@@ -289,16 +262,15 @@ int main(int argc, char **argv) {
   unsigned num_threads = std::thread::hardware_concurrency();
   // Get cores info
 
-#ifdef LZO
   // Initialize decompressor
-  if(lzo_init() != LZO_E_OK) {
+  if(!codec_init()) {
     INFO(std::cerr, "Internal error - lzo_init() failed!");
     INFO(std::cerr, "This usually indicates a compiler bug - try recompiling\nwithout optimizations, and enable '-DLZO_DEBUG' for diagnostics.");
     exit(-1);
   }
   // Initialize decompressor
-#endif
 
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
   std::string dir = traces_data.string();
   std::map<unsigned, TraceInfo> traces;
 
@@ -311,103 +283,63 @@ int main(int argc, char **argv) {
   if(boost::filesystem::is_directory(dir) && (begin_it != end_it)) {
     if ("." != boost::filesystem::path(dir).filename())
       dir += boost::filesystem::path::preferred_separator;
-    for(auto& entry : boost::make_iterator_range(boost::filesystem::directory_iterator(dir), {})) {
-      if (entry.path().filename().string().find("metafile_") != std::string::npos) {
-        unsigned tid;
-        sscanf(entry.path().filename().string().c_str(), "metafile_%d", &tid);
-        std::string filename(dir + entry.path().filename().string());
-        std::ifstream file(filename);
-        std::string str;
-        while (std::getline(file, str))	{
-          uint64_t pid, ppid, bid, obegin, oend;
-          int level;
-          unsigned span, offset;
-          sscanf(str.c_str(), "%lu,%lu,%lu,%u,%u,%d,%lu,%lu\n", &pid, &ppid, &bid, &offset, &span, &level, &obegin, &oend);
-          if((pregion == pid) && (barrier_id == bid)) {
-            traces[tid] = TraceInfo(obegin, oend);
-          }
-        }
-      }
-    }
-
-    // Struct to load uncompressed data from file
-    std::vector<std::thread> lm_thread;
-    lm_thread.reserve(traces.size());
-    std::list<TreeRoot> interval_trees;
-    for(std::map<unsigned, TraceInfo>::iterator th = traces.begin(); th != traces.end(); ++th) {
-      rb_root *root = new rb_root();
-      interval_trees.push_back(TreeRoot(th->first, root));
-      lm_thread.push_back(std::thread(load_and_convert_file, dir, th->first, th->second.file_offset_begin, th->second.file_offset_end, root));
-    }
-    for(int k = 0; k < lm_thread.size(); k++) {
-      lm_thread[k].join();
+    ContainerReader container;
+    if(!container.open(dir)) {
+      INFO(std::cerr, "SWORD: Error opening trace container in: " << dir << " - the execution did not terminate or the traces are from an older version.");
+      exit(-1);
     }
-    lm_thread.clear();
-
+    load_sites(dir);
+    if(stats)
+      print_container_stats(container);
+    if(!single) {
+      jobs = std::max(1u, jobs ? jobs : num_threads);
 #ifdef PRINT
-    if(print) {
-      for(std::list<TreeRoot>::iterator it = interval_trees.begin();
-          it != interval_trees.end(); it++) {
-        std::ofstream out0("thread" + std::to_string(it->tid) + ".dot");
-        std::streambuf *coutbuf0 = std::cout.rdbuf();
-        std::cout.rdbuf(out0.rdbuf());
-        interval_tree_print(it->root);
-        std::cout.rdbuf(coutbuf0);
-      }
-    }
+      // The trees of an interval go to the same files.
+      if(print)
+        jobs = 1;
 #endif // PRINT
-
-    std::vector<std::pair<interval_tree_node,interval_tree_node>> rep_races;
-    std::list<TreeRoot>::iterator it;
-    std::list<TreeRoot>::iterator del;
-    bool last;
-    while(interval_trees.size() > 1) {
-      int lst_size = interval_trees.size();
-      it = interval_trees.begin();
-      while(lst_size != 1 && it != interval_trees.end()) {
-        last = (interval_trees.size() == 2);
-        TreeRoot tree1 = *it;
-        std::advance(it, 1);
-        TreeRoot tree2 = *it;
-        del = it;
-        std::advance(it, 1);
-        interval_trees.erase(del);
-        lst_size -= 2;
-        lm_thread.push_back(std::thread(analyze_trees, last, tree1.tid, tree1.root, tree2.tid, tree2.root, std::ref(rep_races)));
-      }
-      for(int k = 0; k < lm_thread.size(); k++) {
-        lm_thread[k].join();
+      // The intervals run side by side, every one with its share of the cores.
+      unsigned share = std::max(1u, num_threads / jobs);
+      if(!loader_options.decode_threads)
+        loader_options.decode_threads = share;
+      if(!loader_options.tree_threads)
+        loader_options.tree_threads = share;
+      analyze_all_intervals(container, jobs, memory ? memory : getTotalSystemMemory() / 2);
+      if(races.size() > 0)
+        SaveReport(report_data.string() + "/" + OFFLINE_REPORT);
+    } else {
+      std::pair<const IntervalRecord *, const IntervalRecord *> intervals = container.find(pregion, barrier_id);
+      uint64_t recorded = 0;
+      uint64_t sampled_out = 0;
+      for(const IntervalRecord *r = intervals.first; r != intervals.second; ++r) {
+        traces[r->tid] = TraceInfo(r->begin, r->end);
+        recorded += r->recorded;
+        sampled_out += r->sampled_out;
       }
-      lm_thread.clear();
-    }
+      save_coverage(pregion, barrier_id, recorded, sampled_out);
 
-#ifdef PRINT
-    if(print) {
-      std::ofstream out("thread.dot");
-      std::streambuf *coutbuf = std::cout.rdbuf(); //save old buf
-      std::cout.rdbuf(out.rdbuf());
-      interval_tree_print(interval_trees.front().root);
-      std::cout.rdbuf(coutbuf);
-    }
-#endif // PRINT
-
-    for(std::vector<std::pair<interval_tree_node,interval_tree_node>>::iterator it = rep_races.begin(); it != rep_races.end(); ++it) {
-      interval_tree_node i = std::get<0>(*it);
-      interval_tree_node j = std::get<1>(*it);
-      ReportRace(i.start,
-                 ((AccessType) (i.size_type & 0x0F)), ((AccessType) (j.size_type & 0x0F)),
-                 i.size_type >> 4,
-                 j.size_type >> 4,
-                 i.pc - 1, j.pc - 1);
-    }
+      analyze_barrier_interval(&container, traces);
 
-    if(races.size() > 0) {
-      std::string filename = report_data.string() + "/" + "race_report_" + std::to_string(pregion);
-      SaveReport(filename);
+      if(races.size() > 0) {
+        std::string filename = report_data.string() + "/" + "race_report_" + std::to_string(pregion);
+        SaveReport(filename);
+      }
     }
   } else {
     INFO(std::cout, "Folder '" << dir << "' does not exists or it's empty. Exiting...");
   }
 
+#ifdef GLPK
+  if(interval_overlap_check)
+    INFO(std::cout, "SWORD: GLPK disagreed on " << interval_overlap_mismatches << " overlap(s) of strided intervals.");
+#endif // GLPK
+  if(stats) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    INFO(std::cout, "SWORD: " << (engine == engine_sweep ? "sweep" : "tree") << " engine, " << seconds << " s.");
+    INFO(std::cout, "SWORD: " << interval_tree_arena_nodes << " tree nodes of " << sizeof(interval_tree_node) << " bytes, "
+         << interval_tree_arena_bytes / MB << " MB of arenas, peak RSS " << usage.ru_maxrss / 1024 << " MB.");
+  }
   exit(0);
 }
@@ -1,14 +1,27 @@
 #ifndef SWORD_RACE_ANALYSIS_H
 #define SWORD_RACE_ANALYSIS_H
 
+#include "rtl/sword_common.h"
+#include "rtl/sword_block.h"
+#include "rtl/sword_container.h"
 #include "interval_tree.h"
+#include "sword-pipeline.h"
+#include "sword-sweep-analysis.h"
+#include "sword-tree-analysis.h"
 #include "sword-tool-common.h"
 
 #include <boost/atomic.hpp>
 
+#include <fstream>
+#include <list>
+#include <map>
+#include <mutex>
 #include <set>
+#include <thread>
 #include <unordered_map>
 
+#define PRINT_RACE 0
+
 struct TraceInfo {
 public:
   uint64_t file_offset_begin;
@@ -23,5 +36,210 @@ public:
 };
 
 boost::filesystem::path traces_data;
+#ifdef PRINT
+// --print, dumps the trees in dot format.
+bool print = false;
+#endif // PRINT
+
+// size_type of every access site, indexed by site id.
+std::vector<uint8_t> site_size_types;
+
+// --engine, how a barrier interval is checked.
+enum AnalysisEngine {
+  engine_tree,  // pairwise merge of interval trees (sword-tree-analysis.h)
+  engine_sweep, // sort and sweep (sword-sweep-analysis.h)
+};
+
+AnalysisEngine engine = engine_tree;
+
+void load_sites(const std::string &dir) {
+  site_size_types.clear();
+  std::ifstream file(dir + SITEFILE);
+  std::string str;
+  while(std::getline(file, str)) {
+    unsigned id, size_type;
+    if(sscanf(str.c_str(), "%u,%u,", &id, &size_type) != 2)
+      continue;
+    if(id >= site_size_types.size())
+      site_size_types.resize(id + 1, 0);
+    site_size_types[id] = size_type;
+  }
+}
+
+void SaveReport(std::string filename) {
+  std::ofstream file(filename, std::ios::out | std::ios::binary);
+  size_t size = races.size();
+  file.write((char*) &size, sizeof(size));
+  file.write(reinterpret_cast<char*>(races.data()), races.size() * sizeof(RaceInfo));
+  file.close();
+}
+
+void ReportRace(uint64_t address, uint8_t rw1, uint8_t rw2, uint8_t size1, uint8_t size2, uint64_t pc1, uint64_t pc2) {
+  std::size_t hash1 = 0;
+  boost::hash_combine(hash1, pc1);
+  boost::hash_combine(hash1, pc2);
+  std::size_t hash2 = 0;
+  boost::hash_combine(hash2, pc2);
+  boost::hash_combine(hash2, pc1);
+  rmtx.lock();
+  const bool reported = (hash_races.find(hash1) != hash_races.end()) || (hash_races.find(hash2) != hash_races.end());
+  rmtx.unlock();
+  if(!reported) {
+    rmtx.lock();
+    hash_races.insert(hash1);
+    hash_races.insert(hash2);
+    races.push_back(RaceInfo(address, rw1, size1, pc1, rw2, size2, pc2));
+    rmtx.unlock();
+
+#if PRINT_RACE
+    std::string race1 = "";
+    std::string race2 = "";
+
+    {
+      std::string command = shell_path + " -c '" + symbolizer_path + " -pretty-print" + " < <(echo \"" + executable + " " + std::to_string(pc1) + "\")'";
+      execute_command(command.c_str(), &race1, 2);
+    }
+
+    {
+      std::string command = shell_path + " -c '" + symbolizer_path + " -pretty-print" + " < <(echo \"" + executable + " " + std::to_string(pc2) + "\")'";
+      execute_command(command.c_str(), &race2, 2);
+    }
+
+    INFO(std::cerr, "--------------------------------------------------");
+    INFO(std::cerr, "WARNING: SWORD: data race (program=" << executable << ")");
+    INFO(std::cerr, AccessTypeStrings[rw1] << " of size " << std::dec << (1 << size1) << " at 0x" << std::hex << address << " in " << race1);
+    INFO(std::cerr, AccessTypeStrings[rw2] << " of size " << std::dec << (1 << size2) << " at 0x" << std::hex << address << " in " << race2);
+    INFO(std::cerr, "--------------------------------------------------");
+    INFO(std::cerr, "");
+#endif
+  }
+}
+
+unsigned long long getTotalSystemMemory()
+{
+  long pages = sysconf(_SC_PHYS_PAGES);
+  long page_size = sysconf(_SC_PAGE_SIZE);
+  return pages * page_size;
+}
+
+// Appends the coverage of a sampled barrier interval to the report, races
+// between sampled-out accesses cannot be reported.
+void save_coverage(uint64_t pid, uint64_t bid, uint64_t recorded, uint64_t sampled_out) {
+  static std::mutex coverage_mtx;
+  if(sampled_out == 0)
+    return;
+  std::unique_lock<std::mutex> lock(coverage_mtx);
+  std::string filename = report_data.string() + "/" + COVERAGE_FILE + std::to_string(pid);
+  FILE *coverage = fopen(filename.c_str(), "a");
+  if(coverage) {
+    fprintf(coverage, COVERAGE_FORMAT, bid, recorded, sampled_out);
+    fclose(coverage);
+  }
+  INFO(std::cout, "SWORD: Parallel region " << pid << ", barrier interval " << bid << ": the sampling recorded " << recorded << " of " << recorded + sampled_out << " accesses.");
+}
+
+void report_races(const TreeRaces &rep_races) {
+  for(TreeRaces::const_iterator it = rep_races.begin(); it != rep_races.end(); ++it) {
+    interval_tree_node i = std::get<0>(*it);
+    interval_tree_node j = std::get<1>(*it);
+    ReportRace(i.start,
+               ((AccessType) (i.size_type & 0x0F)), ((AccessType) (j.size_type & 0x0F)),
+               i.size_type >> 4,
+               j.size_type >> 4,
+               i.pc - 1, j.pc - 1);
+  }
+}
+
+// Loads the intervals of the threads of a barrier interval into flat arrays
+// (sword-pipeline.h), sorts them and sweeps them for overlapping accesses.
+void sweep_barrier_interval(const ContainerReader *container, const std::map<unsigned, TraceInfo> &traces,
+                            TreeRaces &races) {
+  interval_tree_locksets locksets(SWEEP_MAX_LOCKSETS);
+  std::vector<SweepIntervals> threads;
+  for(std::map<unsigned, TraceInfo>::const_iterator th = traces.begin(); th != traces.end(); ++th)
+    threads.push_back(SweepIntervals(th->first));
+  TraceLoader loader(container, site_size_types);
+  for(SweepIntervals &intervals : threads) {
+    const TraceInfo &info = traces.at(intervals.tid);
+    SweepIntervals *t = &intervals;
+    loader.add(intervals.tid, info.file_offset_begin, info.file_offset_end,
+               [t, &locksets](const TraceItem *begin, const TraceItem *end, std::set<size_t> &mutex) {
+                 sweep_insert_items(begin, end, mutex, site_size_types, &locksets, *t);
+               });
+  }
+  loader.run(loader_options);
+  if(locksets.overflowed()) {
+    INFO(std::cerr, "SWORD: More than " << SWEEP_MAX_LOCKSETS - 1 << " locksets in a barrier interval, the interval is not analyzed.");
+    return;
+  }
+  for(SweepIntervals &intervals : threads)
+    intervals.sort();
+  sweep_intervals(threads, &locksets, races);
+}
+
+// Builds the interval trees of the threads of a barrier interval from their
+// blocks, one tree per thread (sword-pipeline.h), then merges them pairwise
+// and checks every pair for overlapping accesses; or sweeps the barrier
+// interval with --engine sweep, or if the locksets of the interval do not
+// fit in the ids of the nodes. The races go to ReportRace().
+void analyze_barrier_interval(const ContainerReader *container, const std::map<unsigned, TraceInfo> &traces) {
+  TreeRaces rep_races;
+  if(engine == engine_sweep) {
+    sweep_barrier_interval(container, traces, rep_races);
+    report_races(rep_races);
+    return;
+  }
+
+  std::list<TreeRoot> interval_trees;
+  interval_tree_locksets locksets;
+  std::vector<interval_tree_root *> roots;
+  TraceLoader loader(container, site_size_types);
+  for(std::map<unsigned, TraceInfo>::const_iterator th = traces.begin(); th != traces.end(); ++th) {
+    interval_tree_root *root = new interval_tree_root(&locksets);
+    roots.push_back(root);
+    interval_trees.push_back(TreeRoot(th->first, root));
+    loader.add(th->first, th->second.file_offset_begin, th->second.file_offset_end, root);
+  }
+  loader.run(loader_options);
+
+#ifdef PRINT
+  if(print) {
+    for(std::list<TreeRoot>::iterator it = interval_trees.begin();
+        it != interval_trees.end(); it++) {
+      std::ofstream out0("thread" + std::to_string(it->tid) + ".dot");
+      std::streambuf *coutbuf0 = std::cout.rdbuf();
+      std::cout.rdbuf(out0.rdbuf());
+      interval_tree_print(it->root);
+      std::cout.rdbuf(coutbuf0);
+    }
+  }
+#endif // PRINT
+
+  bool overflowed = locksets.overflowed();
+  if(!overflowed)
+    check_trees(interval_trees, true, rmtx, rep_races);
+
+#ifdef PRINT
+  if(print) {
+    std::ofstream out("thread.dot");
+    std::streambuf *coutbuf = std::cout.rdbuf(); //save old buf
+    std::cout.rdbuf(out.rdbuf());
+    interval_tree_print(interval_trees.front().root);
+    std::cout.rdbuf(coutbuf);
+  }
+#endif // PRINT
+
+  // Merged trees are empty, except the two of the last pair.
+  for(interval_tree_root *root : roots) {
+    interval_tree_free(root);
+    delete root;
+  }
+
+  if(overflowed) {
+    INFO(std::cerr, "SWORD: More than " << MAX_LOCKSETS - 1 << " locksets in a barrier interval, the interval is swept.");
+    sweep_barrier_interval(container, traces, rep_races);
+  }
+  report_races(rep_races);
+}
 
 #endif // SWORD_RACE_ANALYSIS_H
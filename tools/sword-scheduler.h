@@ -0,0 +1,146 @@
+// Work-stealing pool of sword-race-analysis, which analyzes all the barrier
+// intervals of a trace container in one process.
+//
+// The tasks are dealt to the workers largest first, round robin, so every
+// worker starts with its largest task and the big intervals do not end up
+// last. A worker takes the front of its deque; once it is empty it steals
+// the front of the worker with the most work left. A task starts when its
+// memory fits in the budget with the tasks running; a task beyond the budget
+// runs alone.
+
+#ifndef SWORD_SCHEDULER_H
+#define SWORD_SCHEDULER_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool {
+ private:
+  struct Task {
+    uint64_t size;   // work, for the order
+    uint64_t memory; // bytes
+    std::function<void()> run;
+  };
+
+  struct Worker {
+    std::mutex mtx;
+    std::deque<Task> tasks;
+    uint64_t size; // left in tasks
+  };
+
+  std::vector<Task> tasks;
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  std::mutex mtx; // memory
+  std::condition_variable cv;
+  uint64_t budget;
+  uint64_t held;
+  unsigned running;
+
+  bool pop(Worker &w, Task &task) {
+    std::unique_lock<std::mutex> lock(w.mtx);
+    if(w.tasks.empty())
+      return false;
+    task = std::move(w.tasks.front());
+    w.tasks.pop_front();
+    w.size -= task.size;
+    return true;
+  }
+
+  bool steal(unsigned self, Task &task) {
+    while(true) {
+      Worker *victim = NULL;
+      uint64_t most = 0;
+      for(unsigned i = 0; i < workers.size(); i++) {
+        if(i == self)
+          continue;
+        std::unique_lock<std::mutex> lock(workers[i]->mtx);
+        if(!workers[i]->tasks.empty() && (!victim || workers[i]->size > most)) {
+          victim = workers[i].get();
+          most = workers[i]->size;
+        }
+      }
+      if(!victim)
+        return false;
+      // The victim may have emptied its deque meanwhile.
+      if(pop(*victim, task)) {
+        stolen++;
+        return true;
+      }
+    }
+  }
+
+  void acquire(uint64_t memory) {
+    std::unique_lock<std::mutex> lock(mtx);
+    while(running > 0 && held + memory > budget) {
+      waited++;
+      cv.wait(lock);
+    }
+    held += memory;
+    running++;
+    peak = std::max<uint64_t>(peak, held);
+  }
+
+  void release(uint64_t memory) {
+    std::unique_lock<std::mutex> lock(mtx);
+    held -= memory;
+    running--;
+    cv.notify_all();
+  }
+
+  void work(unsigned self) {
+    Task task;
+    while(pop(*workers[self], task) || steal(self, task)) {
+      acquire(task.memory);
+      task.run();
+      release(task.memory);
+    }
+  }
+
+ public:
+  std::atomic<uint64_t> stolen;
+  uint64_t waited; // times a task waited for memory
+  uint64_t peak;   // bytes, estimated
+
+  WorkStealingPool(unsigned nworkers, uint64_t memory)
+    : budget(memory), held(0), running(0), stolen(0), waited(0), peak(0) {
+    for(unsigned i = 0; i < std::max(1u, nworkers); i++)
+      workers.push_back(std::unique_ptr<Worker>(new Worker()));
+  }
+
+  void add(uint64_t size, uint64_t memory, std::function<void()> run) {
+    tasks.push_back({ size, memory, run });
+  }
+
+  // Runs the tasks added so far, returns when they are all done.
+  void run() {
+    std::stable_sort(tasks.begin(), tasks.end(), [](const Task &a, const Task &b) {
+        return a.size > b.size;
+      });
+    for(unsigned i = 0; i < workers.size(); i++)
+      workers[i]->size = 0;
+    for(size_t i = 0; i < tasks.size(); i++) {
+      Worker &w = *workers[i % workers.size()];
+      w.size += tasks[i].size;
+      w.tasks.push_back(std::move(tasks[i]));
+    }
+    tasks.clear();
+
+    std::vector<std::thread> threads;
+    for(unsigned i = 0; i < workers.size(); i++)
+      threads.push_back(std::thread(&WorkStealingPool::work, this, i));
+    for(std::thread &thread : threads)
+      thread.join();
+  }
+};
+
+#endif // SWORD_SCHEDULER_H
@@ -0,0 +1,299 @@
+// Sort-and-sweep race check of a barrier interval, the alternative to the
+// pairwise merge of the interval trees (sword-race-analysis --engine sweep).
+//
+// The accesses of a thread go to flat arrays, one per field of an interval;
+// a single access that extends the last run of its site, size, type and
+// lockset is folded into it, as the trees do. The intervals of every thread
+// are radix sorted by start address, then a sweep walks the threads in
+// address order and checks every interval against the still open intervals
+// of the other threads. The trees compare a node only with the nodes on its
+// insertion path, the sweep with every interval it overlaps.
+
+#ifndef SWORD_SWEEP_ANALYSIS_H
+#define SWORD_SWEEP_ANALYSIS_H
+
+#include "rtl/sword_common.h"
+#include "tools/interval_tree.h"
+#include "sword-tree-analysis.h"
+
+#include <stdint.h>
+
+#include <queue>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The lockset ids are kept in 32-bit arrays, not in the 24 bits of a node.
+#define SWEEP_MAX_LOCKSETS	UINT32_MAX
+
+// Intervals of a thread, struct of arrays. An interval spans [start, last]
+// with a stride, the number of accesses is derived as in interval_tree_node.
+struct SweepIntervals {
+  unsigned tid;
+  std::vector<size_t> start;
+  std::vector<size_t> last;
+  std::vector<uint32_t> stride;
+  std::vector<uint8_t> size_type;
+  std::vector<size_t> pc;
+  std::vector<uint32_t> lockset;
+
+  struct RunKey {
+    size_t pc;
+    uint32_t lockset;
+    uint8_t size_type;
+
+    bool operator==(const RunKey &other) const {
+      return pc == other.pc && lockset == other.lockset && size_type == other.size_type;
+    }
+  };
+
+  struct RunKeyHash {
+    size_t operator()(const RunKey &key) const {
+      return key.pc * 31 + ((size_t) key.lockset << 8 | key.size_type);
+    }
+  };
+
+  // Last interval of every site, size, type and lockset, while loading.
+  std::unordered_map<RunKey, size_t, RunKeyHash> runs;
+
+  SweepIntervals(unsigned t) : tid(t) {}
+
+  size_t size() const {
+    return start.size();
+  }
+
+  // The overlap check of the node ignores its mutex, which keeps the low
+  // bits of the lockset only.
+  interval_tree_node node(size_t i) const {
+    interval_tree_node n(start[i], last[i], size_type[i], pc[i], lockset[i]);
+    n.diff = stride[i];
+    return n;
+  }
+
+  void push(size_t s, size_t l, uint32_t d, uint8_t st, size_t p, uint32_t ls) {
+    start.push_back(s);
+    last.push_back(l);
+    stride.push_back(d);
+    size_type.push_back(st);
+    pc.push_back(p);
+    lockset.push_back(ls);
+  }
+
+  // Adds a strided run of count accesses, or a single access if count is 1.
+  void add(size_t s, int64_t d, uint32_t count, uint8_t st, size_t p, uint32_t ls) {
+    RunKey key = { p, ls, st };
+    if(count > 1 && d != 0) {
+      if(d < 0) {
+        s += d * (int64_t) (count - 1);
+        d = -d;
+      }
+      runs[key] = size();
+      push(s, s + d * (count - 1), d, st, p, ls);
+      return;
+    }
+
+    std::unordered_map<RunKey, size_t, RunKeyHash>::iterator it = runs.find(key);
+    if(it != runs.end()) {
+      size_t r = it->second;
+      if(stride[r] == 0) {
+        size_t diff = s - start[r];
+        if(diff == 0)
+          return;
+        if(diff < 64) {
+          stride[r] = diff;
+          last[r] = s;
+          return;
+        }
+      } else {
+        size_t end = start[r] + stride[r] * ((last[r] - start[r]) / stride[r]);
+        if(s == end + stride[r]) {
+          last[r] = s;
+          return;
+        }
+        if(s >= start[r] && s <= end && (s - start[r]) % stride[r] == 0)
+          return;
+        if(start[r] >= stride[r] && s == start[r] - stride[r]) {
+          start[r] = s;
+          return;
+        }
+      }
+    }
+    runs[key] = size();
+    push(s, s, 0, st, p, ls);
+  }
+
+  // Sorts the intervals by start address, least significant digit first,
+  // skipping the digits that all the starts share, and drops the repeated
+  // intervals.
+  void sort() {
+    runs.clear();
+    size_t n = size();
+    if(n < 2)
+      return;
+    std::vector<uint32_t> order(n), next(n);
+    for(size_t i = 0; i < n; i++)
+      order[i] = i;
+    size_t common = ~(size_t) 0, first = start[0];
+    for(size_t i = 1; i < n; i++)
+      common &= ~(start[i] ^ first);
+    std::vector<size_t> counts(1 << 16);
+    for(unsigned shift = 0; shift < 64; shift += 16) {
+      if(((common >> shift) & 0xFFFF) == 0xFFFF)
+        continue;
+      std::fill(counts.begin(), counts.end(), 0);
+      for(size_t i = 0; i < n; i++)
+        counts[(start[i] >> shift) & 0xFFFF]++;
+      size_t sum = 0;
+      for(size_t &count : counts) {
+        size_t c = count;
+        count = sum;
+        sum += c;
+      }
+      for(size_t i = 0; i < n; i++)
+        next[counts[(start[order[i]] >> shift) & 0xFFFF]++] = order[i];
+      order.swap(next);
+    }
+    gather(start, order);
+    gather(last, order);
+    gather(stride, order);
+    gather(size_type, order);
+    gather(pc, order);
+    gather(lockset, order);
+
+    size_t kept = 1;
+    for(size_t i = 1; i < n; i++) {
+      bool repeated = false;
+      for(size_t j = kept; j-- > 0 && start[j] == start[i];) {
+        if(last[j] == last[i] && stride[j] == stride[i] && size_type[j] == size_type[i] &&
+           pc[j] == pc[i] && lockset[j] == lockset[i]) {
+          repeated = true;
+          break;
+        }
+      }
+      if(repeated)
+        continue;
+      start[kept] = start[i];
+      last[kept] = last[i];
+      stride[kept] = stride[i];
+      size_type[kept] = size_type[i];
+      pc[kept] = pc[i];
+      lockset[kept] = lockset[i];
+      kept++;
+    }
+    start.resize(kept);
+    last.resize(kept);
+    stride.resize(kept);
+    size_type.resize(kept);
+    pc.resize(kept);
+    lockset.resize(kept);
+  }
+
+ private:
+  template<typename T>
+  static void gather(std::vector<T> &v, const std::vector<uint32_t> &order) {
+    std::vector<T> sorted(v.size());
+    for(size_t i = 0; i < order.size(); i++)
+      sorted[i] = v[order[i]];
+    v.swap(sorted);
+  }
+};
+
+// Adds the accesses of [begin, end) to the intervals of a thread, mutex is
+// the lockset of the thread, as insert_items() for the trees.
+static void sweep_insert_items(const TraceItem *begin, const TraceItem *end, std::set<size_t> &mutex,
+                               const std::vector<uint8_t> &site_size_types, interval_tree_locksets *locksets,
+                               SweepIntervals &intervals) {
+  uint32_t lockset = locksets->intern(mutex);
+  for(const TraceItem *it = begin; it != end; ++it) {
+    size_t address, pc;
+    uint8_t size_type;
+    switch(it->getType()) {
+    case data_access:
+      address = it->data.access.address;
+      size_type = it->data.access.size_type;
+      pc = (size_t) it->data.access.pc.num;
+      break;
+    case site_access: {
+      uint32_t site = it->data.site_access.getSite();
+      address = it->data.site_access.getAddress();
+      size_type = (site < site_size_types.size()) ? site_size_types[site] : 0;
+      pc = SITE_PC_FLAG | site;
+      break;
+    }
+    case mutex_acquired:
+      mutex.insert(it->data.mutex_region.getWaitId());
+      lockset = locksets->intern(mutex);
+      continue;
+    case mutex_released:
+      mutex.erase(it->data.mutex_region.getWaitId());
+      lockset = locksets->intern(mutex);
+      continue;
+    default:
+      continue;
+    }
+    int64_t stride = 0;
+    uint32_t count = 1;
+    if((it + 1) != end && (it + 1)->getType() == access_run) {
+      ++it;
+      stride = it->data.access_run.getStride();
+      count = it->data.access_run.getCount();
+    }
+    intervals.add(address, stride, count, size_type, pc, lockset);
+  }
+}
+
+// Checks the sorted intervals of the threads of a barrier interval, the
+// races go to races once per pair of pcs.
+static void sweep_intervals(std::vector<SweepIntervals> &threads, interval_tree_locksets *locksets,
+                            TreeRaces &races) {
+  struct Open {
+    unsigned thread;
+    size_t index;
+    size_t last;
+  };
+  typedef std::pair<size_t, unsigned> Cursor; // start, thread
+
+  interval_tree_lockset_cache cache(locksets);
+  std::set<std::pair<size_t, size_t>> reported;
+  std::vector<size_t> next(threads.size(), 0);
+  std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> heads;
+  for(unsigned t = 0; t < threads.size(); t++) {
+    if(threads[t].size() > 0)
+      heads.push(Cursor(threads[t].start[0], t));
+  }
+
+  std::vector<Open> open;
+  while(!heads.empty()) {
+    unsigned t = heads.top().second;
+    heads.pop();
+    SweepIntervals &intervals = threads[t];
+    size_t i = next[t]++;
+    if(next[t] < intervals.size())
+      heads.push(Cursor(intervals.start[next[t]], t));
+
+    size_t start = intervals.start[i];
+    interval_tree_node node = intervals.node(i);
+    for(size_t k = 0; k < open.size();) {
+      if(open[k].last < start) {
+        open[k] = open.back();
+        open.pop_back();
+        continue;
+      }
+      if(open[k].thread != t) {
+        SweepIntervals &other = threads[open[k].thread];
+        size_t j = open[k].index;
+        if(!cache.intersect(intervals.lockset[i], other.lockset[j])) {
+          interval_tree_node parent = other.node(j);
+          if(interval_tree_conflict(other.tid, &parent, intervals.tid, &node) &&
+             reported.insert(std::make_pair(node.pc, parent.pc)).second)
+            races.emplace_back(node, parent);
+        }
+      }
+      k++;
+    }
+    open.push_back({ t, i, intervals.last[i] });
+  }
+}
+
+#endif // SWORD_SWEEP_ANALYSIS_H
@@ -1,6 +1,8 @@
 #ifndef TOOLS_SWORD_TOOL_COMMON_H_
 #define TOOLS_SWORD_TOOL_COMMON_H_
 
+#include "rtl/sword_common.h"
+
 #include <boost/functional/hash.hpp>
 #include <boost/range/iterator_range.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -17,37 +19,6 @@
 #define GET_SYMBOLIZER		"which llvm-symbolizer"
 #define MB					1048576.00
 
-struct RaceInfo {
-	uint64_t address;
-	uint8_t rw1;
-	uint8_t size1;
-	uint64_t pc1;
-	uint8_t rw2;
-	uint8_t size2;
-	uint64_t pc2;
-
-	RaceInfo(uint64_t address, uint8_t rw1, uint8_t size1, uint64_t pc1,
-			uint8_t rw2, uint8_t size2, uint64_t pc2) {
-		this->address = address;
-		this->rw1 = rw1;
-		this->size1 = size1;
-		this->pc1 = pc1;
-		this->rw2 = rw2;
-		this->size2 = size2;
-		this->pc2 = pc2;
-	}
-
-	RaceInfo() {
-		this->address = 0;
-		this->rw1 = 0;
-		this->size1 = 0;
-		this->pc1 = 0;
-		this->rw2 = 0;
-		this->size2 = 0;
-		this->pc2 = 0;
-	}
-};
-
 std::string executable;
 uint64_t pregion;
 uint64_t barrier_id;
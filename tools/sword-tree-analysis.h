@@ -0,0 +1,130 @@
+// Interval trees of a barrier interval: conversion of the trace items of a
+// thread into its tree, and the pairwise merge of the trees of the threads
+// with the overlap check. Shared by the analysis tools and the in-process
+// analysis of the run-time (SWORD_OPTIONS inprocess=1), whose symbols must
+// not leak into the program, hence the static functions.
+
+#ifndef SWORD_TREE_ANALYSIS_H
+#define SWORD_TREE_ANALYSIS_H
+
+#include "rtl/sword_common.h"
+#include "tools/interval_tree.h"
+
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct TreeRoot {
+  unsigned tid;
+  interval_tree_root *root;
+
+  TreeRoot(int id, interval_tree_root *r) {
+    tid = id;
+    root = r;
+  }
+};
+
+typedef std::vector<std::pair<interval_tree_node, interval_tree_node>> TreeRaces;
+
+// Releases the nodes of a tree, the root can be reused.
+static void interval_tree_free(interval_tree_root *root) {
+  root->rb_node = NULL;
+  root->arena.clear();
+}
+
+static void analyze_trees(std::mutex &mtx, bool last, unsigned t1, interval_tree_root *tree1, unsigned t2, interval_tree_root *tree2,
+                          TreeRaces &races) {
+  if(tree1 && tree2) {
+    interval_tree_overlap(mtx, t1, tree1, t2, tree2, races);
+    if(!last)
+      interval_tree_merge(tree1, tree2);
+  }
+}
+
+// An access followed by an access_run item is the first of a strided run,
+// which is inserted as a single interval.
+static void insert_access(interval_tree_node node, const TraceItem *&it, const TraceItem *end,
+                          interval_tree_root *root, unsigned t) {
+  if((it + 1) != end && (it + 1)->getType() == access_run) {
+    ++it;
+    int64_t stride = it->data.access_run.getStride();
+    uint32_t count = it->data.access_run.getCount();
+    if(count > 1 && stride != 0) {
+      if(stride < 0) {
+        node.start += stride * (int64_t) (count - 1);
+        stride = -stride;
+      }
+      node.diff = stride;
+      node.last = node.start + stride * (count - 1);
+    }
+  }
+  interval_tree_insert_data(node, root, t);
+}
+
+// Inserts the accesses of [begin, end) into the tree of thread t, mutex is
+// the lockset of the thread. site_size_types is indexed by site id.
+static void insert_items(const TraceItem *begin, const TraceItem *end, std::set<size_t> &mutex,
+                         const std::vector<uint8_t> &site_size_types, interval_tree_root *root, unsigned t) {
+  uint32_t lockset = root->locksets->intern(mutex);
+  for(const TraceItem *it = begin; it != end; ++it) {
+    switch(it->getType()) {
+    case data_access:
+      insert_access(interval_tree_node(it->data.access.address, it->data.access.address, it->data.access.size_type, (size_t) it->data.access.pc.num, lockset), it, end, root, t);
+      break;
+    case site_access: {
+      uint32_t site = it->data.site_access.getSite();
+      uint8_t size_type = (site < site_size_types.size()) ? site_size_types[site] : 0;
+      insert_access(interval_tree_node(it->data.site_access.getAddress(), it->data.site_access.getAddress(), size_type, SITE_PC_FLAG | site, lockset), it, end, root, t);
+      break;
+    }
+    case mutex_acquired:
+      mutex.insert(it->data.mutex_region.getWaitId());
+      lockset = root->locksets->intern(mutex);
+      break;
+    case mutex_released:
+      mutex.erase(it->data.mutex_region.getWaitId());
+      lockset = root->locksets->intern(mutex);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+// Merges the trees pairwise, in rounds, and collects the overlapping
+// accesses of every pair in races. A round runs its pairs on threads if
+// parallel is set. The trees are not released.
+static void check_trees(std::list<TreeRoot> &interval_trees, bool parallel, std::mutex &mtx, TreeRaces &races) {
+  std::vector<std::thread> lm_thread;
+  std::list<TreeRoot>::iterator it;
+  std::list<TreeRoot>::iterator del;
+  bool last;
+  while(interval_trees.size() > 1) {
+    int lst_size = interval_trees.size();
+    it = interval_trees.begin();
+    while(lst_size != 1 && it != interval_trees.end()) {
+      last = (interval_trees.size() == 2);
+      TreeRoot tree1 = *it;
+      std::advance(it, 1);
+      TreeRoot tree2 = *it;
+      del = it;
+      std::advance(it, 1);
+      interval_trees.erase(del);
+      lst_size -= 2;
+      if(parallel)
+        lm_thread.push_back(std::thread(analyze_trees, std::ref(mtx), last, tree1.tid, tree1.root, tree2.tid, tree2.root, std::ref(races)));
+      else
+        analyze_trees(mtx, last, tree1.tid, tree1.root, tree2.tid, tree2.root, races);
+    }
+    for(int k = 0; k < lm_thread.size(); k++) {
+      lm_thread[k].join();
+    }
+    lm_thread.clear();
+  }
+}
+
+#endif // SWORD_TREE_ANALYSIS_H